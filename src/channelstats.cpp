@@ -0,0 +1,52 @@
+/*
+	mv2mariadb - convert MediathekView db to mariadb
+	Copyright (C) 2015-2017, M. Liebmann 'micha-bbg'
+
+	License: GPL
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public
+	License as published by the Free Software Foundation; either
+	version 2 of the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public
+	License along with this program; if not, write to the
+	Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+	Boston, MA  02110-1301, USA.
+*/
+
+#include <limits.h>
+
+#include <algorithm>
+
+#include "channelstats.h"
+
+void addChannelStat(videoInfoMap_t& videoInfo, uint32_t channelId, int date)
+{
+	/* Keyed by channel, so the list doesn't have to be grouped by channel. */
+	TVideoInfoEntry& vie = videoInfo[channelId];
+	if (vie.count == 0) {
+		vie.id        = 0;
+		vie.channelId = channelId;
+		vie.latest    = INT_MIN;
+		vie.oldest    = INT_MAX;
+	}
+	vie.count++;
+	vie.latest = max(date, vie.latest);
+	if (date != 0)
+		vie.oldest = min(date, vie.oldest);
+}
+
+void removeChannelStat(videoInfoMap_t& videoInfo, uint32_t channelId)
+{
+	videoInfoMap_t::iterator it = videoInfo.find(channelId);
+	if (it == videoInfo.end())
+		return;
+	if (--(it->second.count) <= 0)
+		videoInfo.erase(it);
+}
@@ -0,0 +1,36 @@
+/*
+	mv2mariadb - convert MediathekView db to mariadb
+	Copyright (C) 2015-2017, M. Liebmann 'micha-bbg'
+
+	License: GPL
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public
+	License as published by the Free Software Foundation; either
+	version 2 of the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public
+	License along with this program; if not, write to the
+	Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+	Boston, MA  02110-1301, USA.
+*/
+
+#ifndef __CHANNELSTATS_H__
+#define __CHANNELSTATS_H__
+
+#include <stdint.h>
+
+#include "types.h"
+
+/* Per channel statistics (count, latest and oldest date) of the
+ * imported entries, independent of the order of the list. */
+void addChannelStat(videoInfoMap_t& videoInfo, uint32_t channelId, int date);
+/* an entry was replaced (url dedup), latest/oldest are kept */
+void removeChannelStat(videoInfoMap_t& videoInfo, uint32_t channelId);
+
+#endif // __CHANNELSTATS_H__
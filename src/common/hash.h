@@ -0,0 +1,51 @@
+
+#ifndef __hash_h__
+#define __hash_h__
+
+#include <stdint.h>
+
+/* MurmurHash64A (Austin Appleby, public domain).
+ * Fast non-cryptographic 64 bit hash, used for hash tables and
+ * fingerprints. The input is read as little endian, so the result is
+ * the same on every host (nkey column of the video table). */
+inline uint64_t hash64(const void* key, size_t len, uint64_t seed = 0)
+{
+	const uint64_t m = 0xc6a4a7935bd1e995ULL;
+	const int r = 47;
+	uint64_t h = seed ^ (len * m);
+
+	const unsigned char* data = static_cast<const unsigned char*>(key);
+	const unsigned char* end  = data + (len & ~static_cast<size_t>(7));
+	while (data != end) {
+		uint64_t k = 0;
+		for (int i = 7; i >= 0; i--)
+			k = (k << 8) | data[i];
+		data += 8;
+		k *= m;
+		k ^= k >> r;
+		k *= m;
+		h ^= k;
+		h *= m;
+	}
+
+	switch (len & 7) {
+		case 7: h ^= static_cast<uint64_t>(data[6]) << 48; /* fall through */
+		case 6: h ^= static_cast<uint64_t>(data[5]) << 40; /* fall through */
+		case 5: h ^= static_cast<uint64_t>(data[4]) << 32; /* fall through */
+		case 4: h ^= static_cast<uint64_t>(data[3]) << 24; /* fall through */
+		case 3: h ^= static_cast<uint64_t>(data[2]) << 16; /* fall through */
+		case 2: h ^= static_cast<uint64_t>(data[1]) << 8;  /* fall through */
+		case 1: h ^= static_cast<uint64_t>(data[0]);
+			h *= m;
+			break;
+		default:
+			break;
+	}
+
+	h ^= h >> r;
+	h *= m;
+	h ^= h >> r;
+	return h;
+}
+
+#endif // __hash_h__
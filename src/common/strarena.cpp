@@ -0,0 +1,60 @@
+
+#include <algorithm>
+
+#include "strarena.h"
+
+CStrArena::CStrArena(size_t chunkSize_/* = 65536*/)
+{
+	chunkSize = chunkSize_;
+	curChunk  = 0;
+	curPos    = 0;
+	used      = 0;
+}
+
+CStrArena::~CStrArena()
+{
+	for (size_t i = 0; i < chunks.size(); i++)
+		delete [] chunks[i];
+	chunks.clear();
+	chunkSizes.clear();
+}
+
+char* CStrArena::alloc(size_t size)
+{
+	/* use the remaining space of existing chunks first */
+	while (curChunk < chunks.size()) {
+		if ((curPos + size) <= chunkSizes[curChunk]) {
+			char* ret = chunks[curChunk] + curPos;
+			curPos += size;
+			used   += size;
+			return ret;
+		}
+		curChunk++;
+		curPos = 0;
+	}
+
+	/* oversized requests get a chunk of their own */
+	size_t newSize = max(size, chunkSize);
+	chunks.push_back(new char[newSize]);
+	chunkSizes.push_back(newSize);
+	curChunk = chunks.size() - 1;
+	curPos   = size;
+	used    += size;
+	return chunks[curChunk];
+}
+
+TStrView CStrArena::copy(const char* data, size_t len)
+{
+	if (len == 0)
+		return strView("", 0);
+	char* p = alloc(len);
+	memcpy(p, data, len);
+	return strView(p, len);
+}
+
+void CStrArena::reset()
+{
+	curChunk = 0;
+	curPos   = 0;
+	used     = 0;
+}
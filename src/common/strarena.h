@@ -0,0 +1,64 @@
+
+#ifndef __strarena_h__
+#define __strarena_h__
+
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/* Non-owning reference to a character range. The referenced
+ * memory (a CStrArena chunk or a std::string) must outlive it. */
+typedef struct StrView
+{
+	const char* data;
+	size_t      len;
+
+	bool   empty() const { return (len == 0); }
+	string str() const { return string(data, len); }
+} TStrView;
+
+inline TStrView strView(const char* data, size_t len)
+{
+	TStrView v;
+	v.data = (data != NULL) ? data : "";
+	v.len  = (data != NULL) ? len : 0;
+	return v;
+}
+
+inline TStrView strView(const string& s)
+{
+	return strView(s.data(), s.length());
+}
+
+/* Bump allocator for short lived strings. Memory is handed out
+ * from fixed size chunks and only released in the destructor,
+ * reset() makes all chunks available again without freeing. */
+class CStrArena
+{
+	private:
+		vector<char*>  chunks;
+		vector<size_t> chunkSizes;
+		size_t chunkSize;
+		size_t curChunk;
+		size_t curPos;
+		size_t used;
+
+		CStrArena(const CStrArena&);
+		CStrArena& operator=(const CStrArena&);
+
+	public:
+		CStrArena(size_t chunkSize_ = 65536);
+		~CStrArena();
+
+		char* alloc(size_t size);
+		TStrView copy(const char* data, size_t len);
+		TStrView copy(TStrView v) { return copy(v.data, v.len); }
+		void reset();
+		size_t bytesUsed() const { return used; }
+};
+
+#endif // __strarena_h__
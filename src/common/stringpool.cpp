@@ -0,0 +1,47 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "stringpool.h"
+
+[[noreturn]] extern void myExit(int val);
+
+CStringPool::CStringPool()
+: arena(262144)
+{
+	memset(idChunks, 0, sizeof(idChunks));
+	count    = 0;
+	refBytes = 0;
+	intern("", 0);
+}
+
+CStringPool::~CStringPool()
+{
+	for (size_t i = 0; i < maxChunks; i++) {
+		if (idChunks[i] != NULL)
+			delete [] idChunks[i];
+	}
+}
+
+uint32_t CStringPool::intern(const char* data, size_t len)
+{
+	refBytes += len;
+	poolMap_t::const_iterator it = poolMap.find(strView(data, len));
+	if (it != poolMap.end())
+		return it->second;
+
+	uint32_t id = count;
+	size_t chunk = id >> chunkBits;
+	if (chunk >= maxChunks) {
+		printf("[%s:%d] string pool overflow (%u entries)\n", __func__, __LINE__, count);
+		myExit(1);
+	}
+	if (idChunks[chunk] == NULL)
+		idChunks[chunk] = new TStrView[chunkEntries];
+
+	TStrView v = arena.copy(data, len);
+	idChunks[chunk][id & (chunkEntries-1)] = v;
+	poolMap.insert(make_pair(v, id));
+	count++;
+	return id;
+}
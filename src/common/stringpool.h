@@ -0,0 +1,63 @@
+
+#ifndef __stringpool_h__
+#define __stringpool_h__
+
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+#include <unordered_map>
+
+#include "hash.h"
+#include "strarena.h"
+
+using namespace std;
+
+/* Interning pool: maps strings to small stable ids and keeps one
+ * canonical copy of each value. Id 0 is always the empty string.
+ * Ids and views returned by str() stay valid for the lifetime
+ * of the pool. */
+class CStringPool
+{
+	private:
+		struct viewHash {
+			size_t operator()(const TStrView& v) const { return static_cast<size_t>(hash64(v.data, v.len)); }
+		};
+		struct viewEqual {
+			bool operator()(const TStrView& a, const TStrView& b) const {
+				return ((a.len == b.len) && (memcmp(a.data, b.data, a.len) == 0));
+			}
+		};
+		typedef unordered_map<TStrView, uint32_t, viewHash, viewEqual> poolMap_t;
+
+		enum {
+			chunkBits    = 12,
+			chunkEntries = 1 << chunkBits,
+			maxChunks    = 4096
+		};
+
+		poolMap_t poolMap;
+		CStrArena arena;
+		/* Fixed chunk table, growing the pool never moves existing entries. */
+		TStrView* idChunks[maxChunks];
+		uint32_t  count;
+		uint64_t  refBytes;
+
+		CStringPool(const CStringPool&);
+		CStringPool& operator=(const CStringPool&);
+
+	public:
+		CStringPool();
+		~CStringPool();
+
+		uint32_t intern(const char* data, size_t len);
+		uint32_t intern(const string& s) { return intern(s.data(), s.length()); }
+		TStrView str(uint32_t id) const { return idChunks[id >> chunkBits][id & (chunkEntries-1)]; }
+		uint32_t size() const { return count; }
+
+		/* payload held by the pool / payload of all interned references */
+		uint64_t bytesStored() const { return arena.bytesUsed(); }
+		uint64_t bytesReferenced() const { return refBytes; }
+};
+
+#endif // __stringpool_h__
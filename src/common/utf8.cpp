@@ -0,0 +1,185 @@
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "utf8.h"
+
+namespace {
+
+/* characters to escape per mode, the second character of the escape sequence */
+struct escapeTables
+{
+	char table[3][128];
+	escapeTables() {
+		memset(table, 0, sizeof(table));
+		char* sql = table[utf8Esc_sql];
+		sql[0]    = '0';
+		sql['\n'] = 'n';
+		sql['\r'] = 'r';
+		sql['\\'] = '\\';
+		sql['\''] = '\'';
+		sql['"']  = '"';
+		sql[032]  = 'Z';
+		char* ld = table[utf8Esc_loadData];
+		ld[0]    = '0';
+		ld['\t'] = 't';
+		ld['\n'] = 'n';
+		ld['\r'] = 'r';
+		ld['\\'] = '\\';
+	}
+};
+
+const escapeTables escTables;
+
+const char specialSql[]      = { '\0', '\n', '\r', '\\', '\'', '"', '\032' };
+const char specialLoadData[] = { '\0', '\t', '\n', '\r', '\\' };
+
+inline unsigned int countTrailingZeros(unsigned int mask)
+{
+	return static_cast<unsigned int>(__builtin_ctz(mask));
+}
+
+/* Number of leading bytes that are ASCII and need no escaping. */
+inline size_t plainRun(const unsigned char* p, const unsigned char* end, int mode)
+{
+	const char* special = (mode == utf8Esc_sql) ? specialSql : specialLoadData;
+	size_t specialCount = (mode == utf8Esc_sql) ? sizeof(specialSql) : (mode == utf8Esc_loadData) ? sizeof(specialLoadData) : 0;
+	const unsigned char* start = p;
+
+#if defined(__AVX2__)
+	while ((end - p) >= 32) {
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+		unsigned int mask = static_cast<unsigned int>(_mm256_movemask_epi8(v));
+		for (size_t i = 0; i < specialCount; i++)
+			mask |= static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(special[i]))));
+		if (mask != 0)
+			return (p - start) + countTrailingZeros(mask);
+		p += 32;
+	}
+#elif defined(__SSE2__)
+	while ((end - p) >= 16) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(v));
+		for (size_t i = 0; i < specialCount; i++)
+			mask |= static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(special[i]))));
+		if (mask != 0)
+			return (p - start) + countTrailingZeros(mask);
+		p += 16;
+	}
+#else
+	(void)special;
+	(void)specialCount;
+#endif
+	const char* esc = escTables.table[mode];
+	while ((p < end) && (*p < 0x80) && (esc[*p] == 0))
+		p++;
+	return p - start;
+}
+
+inline bool isCont(unsigned char c) { return ((c & 0xC0) == 0x80); }
+
+/* Length of the valid UTF-8 sequence at p (limit = end of the value),
+ * 0 if the bytes at p are no valid sequence. */
+inline size_t sequenceLen(const unsigned char* p, const unsigned char* limit)
+{
+	unsigned char c = p[0];
+	size_t avail = limit - p;
+	if ((c >= 0xC2) && (c <= 0xDF))
+		return ((avail >= 2) && isCont(p[1])) ? 2 : 0;
+	if ((c >= 0xE0) && (c <= 0xEF)) {
+		if ((avail < 3) || !isCont(p[1]) || !isCont(p[2]))
+			return 0;
+		if ((c == 0xE0) && (p[1] < 0xA0))	/* overlong */
+			return 0;
+		if ((c == 0xED) && (p[1] > 0x9F))	/* surrogates */
+			return 0;
+		return 3;
+	}
+	if ((c >= 0xF0) && (c <= 0xF4)) {
+		if ((avail < 4) || !isCont(p[1]) || !isCont(p[2]) || !isCont(p[3]))
+			return 0;
+		if ((c == 0xF0) && (p[1] < 0x90))	/* overlong */
+			return 0;
+		if ((c == 0xF4) && (p[1] > 0x8F))	/* > U+10FFFF */
+			return 0;
+		return 4;
+	}
+	return 0;
+}
+
+} // namespace
+
+size_t utf8Escape(char* out, const char* in, size_t len, size_t maxLen, int mode, TUtf8Stats* stats)
+{
+	const unsigned char* p     = reinterpret_cast<const unsigned char*>(in);
+	const unsigned char* limit = p + len;
+	const unsigned char* end   = p + ((len > maxLen) ? maxLen : len);
+	const char* esc = escTables.table[mode];
+	char* o = out;
+	bool repaired = false;
+
+	while (p < end) {
+		size_t run = plainRun(p, end, mode);
+		memcpy(o, p, run);
+		o += run;
+		p += run;
+		if (p >= end)
+			break;
+
+		unsigned char c = *p;
+		if (c < 0x80) {
+			*o++ = '\\';
+			*o++ = esc[c];
+			p++;
+			continue;
+		}
+		size_t seq = sequenceLen(p, limit);
+		if (seq == 0) {
+			*o++ = '?';
+			p++;
+			repaired = true;
+			continue;
+		}
+		if ((p + seq) > end)	/* don't cut a code point */
+			break;
+		memcpy(o, p, seq);
+		o += seq;
+		p += seq;
+	}
+
+	if (stats != NULL) {
+		if (len > maxLen)
+			stats->truncated++;
+		if (repaired)
+			stats->repaired++;
+	}
+	return o - out;
+}
+
+bool utf8Check(const char* in, size_t len, size_t maxLen, size_t* outLen, TUtf8Stats* stats)
+{
+	const unsigned char* start = reinterpret_cast<const unsigned char*>(in);
+	const unsigned char* p     = start;
+	const unsigned char* limit = p + len;
+	const unsigned char* end   = p + ((len > maxLen) ? maxLen : len);
+
+	while (p < end) {
+		p += plainRun(p, end, utf8Esc_none);
+		if (p >= end)
+			break;
+		size_t seq = sequenceLen(p, limit);
+		if (seq == 0)
+			return false;
+		if ((p + seq) > end)
+			break;
+		p += seq;
+	}
+
+	*outLen = p - start;
+	if ((stats != NULL) && (len > maxLen))
+		stats->truncated++;
+	return true;
+}
@@ -0,0 +1,32 @@
+
+#ifndef __utf8_h__
+#define __utf8_h__
+
+#include <stdint.h>
+#include <string.h>
+
+typedef struct Utf8Stats
+{
+	uint64_t truncated;	/* values cut to the column limit */
+	uint64_t repaired;	/* values with invalid UTF-8 bytes */
+} TUtf8Stats;
+
+enum {
+	utf8Esc_none,		/* validate / truncate only */
+	utf8Esc_sql,		/* rules of mysql_real_escape_string() */
+	utf8Esc_loadData	/* LOAD DATA ... ESCAPED BY '\\' */
+};
+
+/* One pass over 'in': cut to at most maxLen bytes at a code point
+ * boundary, replace every invalid UTF-8 byte by '?' and escape for
+ * 'mode'. 'out' needs room for 2*min(len, maxLen) bytes. Runs of
+ * plain ASCII are skipped with SSE2 / AVX2 where available.
+ * Returns the number of bytes written. */
+size_t utf8Escape(char* out, const char* in, size_t len, size_t maxLen, int mode, TUtf8Stats* stats);
+
+/* Like utf8Escape(utf8Esc_none) without copying: returns false if
+ * 'in' needs a repair (then stats are not touched), else true with
+ * the truncated length in *outLen. */
+bool utf8Check(const char* in, size_t len, size_t maxLen, size_t* outLen, TUtf8Stats* stats);
+
+#endif // __utf8_h__
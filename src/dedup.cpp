@@ -0,0 +1,142 @@
+/*
+	mv2mariadb - convert MediathekView db to mariadb
+	Copyright (C) 2015-2017, M. Liebmann 'micha-bbg'
+
+	License: GPL
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public
+	License as published by the Free Software Foundation; either
+	version 2 of the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public
+	License along with this program; if not, write to the
+	Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+	Boston, MA  02110-1301, USA.
+*/
+
+#include <ctype.h>
+#include <stdio.h>
+#include <strings.h>
+
+#include <algorithm>
+#include <sstream>
+
+#include "dedup.h"
+#include "common/hash.h"
+
+CUrlDedup::CUrlDedup()
+{
+	policy      = policy_off;
+	maxKeys     = 0;
+	lastHash    = 0;
+	lastTracked = false;
+	dropped     = 0;
+	replaced    = 0;
+	untracked   = 0;
+}
+
+CUrlDedup::~CUrlDedup()
+{
+	keys.clear();
+}
+
+void CUrlDedup::setup(int policy_, size_t maxKeys_)
+{
+	if ((policy_ < policy_off) || (policy_ > policy_keepNewest)) {
+		printf("[%s:%d] invalid urlDedup %d, deduplication disabled\n", __func__, __LINE__, policy_);
+		policy_ = policy_off;
+	}
+	policy  = policy_;
+	maxKeys = maxKeys_;
+	keys.clear();
+	if (enabled())
+		keys.reserve(min(maxKeys, static_cast<size_t>(1 << 20)));
+	dropped   = 0;
+	replaced  = 0;
+	untracked = 0;
+}
+
+uint64_t CUrlDedup::urlHash(TStrView url)
+{
+	/* http and https copies of the same url are equal, the
+	   host name is case-insensitive, a trailing '/' is ignored */
+	const char* p   = url.data;
+	const char* end = url.data + url.len;
+	if ((url.len > 7) && (strncasecmp(p, "http://", 7) == 0))
+		p += 7;
+	else if ((url.len > 8) && (strncasecmp(p, "https://", 8) == 0))
+		p += 8;
+	while ((end > p) && (*(end-1) == '/'))
+		end--;
+
+	normBuf.assign(p, end - p);
+	size_t host = normBuf.find('/');
+	if (host == string::npos)
+		host = normBuf.length();
+	for (size_t i = 0; i < host; i++)
+		normBuf[i] = static_cast<char>(tolower(static_cast<unsigned char>(normBuf[i])));
+
+	return hash64(normBuf.data(), normBuf.length());
+}
+
+int CUrlDedup::check(TStrView url, int date_unix, urlKey_t* prev)
+{
+	lastTracked = false;
+	if (!enabled() || url.empty())
+		return result_new;
+
+	lastHash = urlHash(url);
+	urlKeyMap_t::const_iterator it = keys.find(lastHash);
+	if (it == keys.end()) {
+		if (keys.size() >= maxKeys) {
+			/* key memory exhausted, keep the entry unchecked */
+			untracked++;
+			return result_new;
+		}
+		lastTracked = true;
+		return result_new;
+	}
+
+	/* A kept copy that is not yet written has no id to replace,
+	   in that case the first copy wins. */
+	if ((policy == policy_keepNewest) && (date_unix > it->second.date_unix) && (it->second.id > 0)) {
+		*prev = it->second;
+		lastTracked = true;
+		replaced++;
+		return result_replace;
+	}
+	dropped++;
+	return result_drop;
+}
+
+void CUrlDedup::record(int32_t id, int date_unix, uint32_t channelId, uint64_t nkey)
+{
+	if (!lastTracked)
+		return;
+	urlKey_t& key = keys[lastHash];
+	key.id        = id;
+	key.date_unix = date_unix;
+	key.channelId = channelId;
+	key.nkey      = nkey;
+	lastTracked   = false;
+}
+
+string CUrlDedup::getStats() const
+{
+	/* node: next pointer + key + value, plus one bucket pointer */
+	size_t keyMem = keys.size() * (sizeof(void*) + sizeof(urlKeyMap_t::value_type)) + keys.bucket_count() * sizeof(void*);
+	ostringstream ret;
+	ret << dropped << " duplicates dropped";
+	if (policy == policy_keepNewest)
+		ret << ", " << replaced << " replaced by a newer copy";
+	ret << ", " << keys.size() << " urls (" << (keyMem / 1024) << " KB)";
+	if (untracked > 0)
+		ret << ", " << untracked << " unchecked (urlDedupMaxKeys reached)";
+	return ret.str();
+}
@@ -0,0 +1,90 @@
+/*
+	mv2mariadb - convert MediathekView db to mariadb
+	Copyright (C) 2015-2017, M. Liebmann 'micha-bbg'
+
+	License: GPL
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public
+	License as published by the Free Software Foundation; either
+	version 2 of the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public
+	License along with this program; if not, write to the
+	Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+	Boston, MA  02110-1301, USA.
+*/
+
+#ifndef __DEDUP_H__
+#define __DEDUP_H__
+
+#include <stdint.h>
+
+#include <string>
+#include <unordered_map>
+
+#include "common/strarena.h"
+
+using namespace std;
+
+/* Drops repeated entries of one list (same broadcast under another
+ * theme, repeats) by a 64 bit hash of the normalised primary url.
+ * Only the hash and the position of the kept copy are stored, the
+ * number of keys is limited by 'urlDedupMaxKeys'. */
+class CUrlDedup
+{
+	public:
+		enum {
+			policy_off,
+			policy_keepFirst,
+			policy_keepNewest
+		};
+
+		enum {
+			result_new,	/* first copy, keep it and call record() */
+			result_drop,	/* duplicate, drop it */
+			result_replace	/* newer duplicate, write it with the id of the kept copy, then call record() */
+		};
+
+		typedef struct {
+			int32_t  id;		/* 0 = not yet written (diff mode insert) */
+			int32_t  date_unix;
+			uint32_t channelId;
+			uint64_t nkey;		/* natural key of the kept copy */
+		} urlKey_t;
+
+	private:
+		typedef unordered_map<uint64_t, urlKey_t> urlKeyMap_t;
+
+		urlKeyMap_t keys;
+		int      policy;
+		size_t   maxKeys;
+		uint64_t lastHash;
+		bool     lastTracked;
+		string   normBuf;
+		uint32_t dropped;
+		uint32_t replaced;
+		uint32_t untracked;
+
+		uint64_t urlHash(TStrView url);
+
+	public:
+		CUrlDedup();
+		~CUrlDedup();
+
+		void setup(int policy_, size_t maxKeys_);
+		bool enabled() const { return (policy != policy_off); }
+
+		int  check(TStrView url, int date_unix, urlKey_t* prev);
+		void record(int32_t id, int date_unix, uint32_t channelId, uint64_t nkey);
+
+		uint32_t droppedEntries() const { return dropped; }
+		string getStats() const;
+};
+
+#endif // __DEDUP_H__
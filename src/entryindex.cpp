@@ -0,0 +1,101 @@
+/*
+	mv2mariadb - convert MediathekView db to mariadb
+	Copyright (C) 2015-2017, M. Liebmann 'micha-bbg'
+
+	License: GPL
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public
+	License as published by the Free Software Foundation; either
+	version 2 of the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public
+	License along with this program; if not, write to the
+	Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+	Boston, MA  02110-1301, USA.
+*/
+
+#include <ctype.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <sstream>
+
+#include "entryindex.h"
+#include "common/hash.h"
+#include "common/utf8.h"
+
+CEntryIndex::CEntryIndex()
+{
+	hits   = 0;
+	misses = 0;
+	loadMs = 0;
+}
+
+CEntryIndex::~CEntryIndex()
+{
+	keys.clear();
+}
+
+void CEntryIndex::clear()
+{
+	keys.clear();
+	hits   = 0;
+	misses = 0;
+	loadMs = 0;
+}
+
+uint64_t CEntryIndex::strHash(TStrView s, size_t maxLen, uint64_t seed)
+{
+	/* same cut and repair as the written column */
+	size_t len;
+	if (utf8Check(s.data, s.len, maxLen, &len, NULL))
+		normBuf.assign(s.data, len);
+	else {
+		normBuf.resize(min(s.len, maxLen));
+		normBuf.resize(utf8Escape(&normBuf[0], s.data, s.len, maxLen, utf8Esc_none, NULL));
+	}
+	for (size_t i = 0; i < normBuf.length(); i++)
+		normBuf[i] = static_cast<char>(tolower(static_cast<unsigned char>(normBuf[i])));
+	return hash64(normBuf.data(), normBuf.length(), seed);
+}
+
+uint64_t CEntryIndex::key(TStrView channel, int32_t date_unix, TStrView theme, TStrView title)
+{
+	/* stored in the database, don't change without a new template */
+	uint64_t h = strHash(channel, 128, static_cast<uint32_t>(date_unix));
+	h = strHash(theme, 1024, h);
+	return strHash(title, 1024, h);
+}
+
+void CEntryIndex::add(uint64_t key_, uint32_t id)
+{
+	uint32_t& entry = keys[key_];
+	entry = max(entry, id);
+}
+
+uint32_t CEntryIndex::find(uint64_t key_)
+{
+	keyMap_t::const_iterator it = keys.find(key_);
+	if (it == keys.end()) {
+		misses++;
+		return 0;
+	}
+	hits++;
+	return it->second;
+}
+
+string CEntryIndex::getStats() const
+{
+	/* node: next pointer + key + value, plus one bucket pointer */
+	size_t keyMem = keys.size() * (sizeof(void*) + sizeof(keyMap_t::value_type)) + keys.bucket_count() * sizeof(void*);
+	ostringstream ret;
+	ret << keys.size() << " keys (" << (keyMem / 1024) << " KB, loaded in ";
+	ret << static_cast<int>(loadMs) << " ms), " << hits << " found, " << misses << " new";
+	return ret.str();
+}
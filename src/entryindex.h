@@ -0,0 +1,71 @@
+/*
+	mv2mariadb - convert MediathekView db to mariadb
+	Copyright (C) 2015-2017, M. Liebmann 'micha-bbg'
+
+	License: GPL
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public
+	License as published by the Free Software Foundation; either
+	version 2 of the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public
+	License along with this program; if not, write to the
+	Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+	Boston, MA  02110-1301, USA.
+*/
+
+#ifndef __ENTRYINDEX_H__
+#define __ENTRYINDEX_H__
+
+#include <stdint.h>
+
+#include <string>
+#include <unordered_map>
+
+#include "common/strarena.h"
+
+using namespace std;
+
+/* Natural key (channel, date_unix, theme, title) -> highest id of the
+ * video table. Only a 64 bit hash of the key is stored; the strings are
+ * cut like the table columns and compared without ASCII case, as the
+ * LIKE of the old query did with the _ci collation. key() is also the
+ * value of the nkey column. The map is loaded once per diff import (from
+ * that column or, for older tables, from the key columns), and the full
+ * import uses it to find entries that occur twice in the list. */
+class CEntryIndex
+{
+	private:
+		typedef unordered_map<uint64_t, uint32_t> keyMap_t;
+
+		keyMap_t keys;
+		string   normBuf;
+		uint32_t hits;
+		uint32_t misses;
+		double   loadMs;
+
+		uint64_t strHash(TStrView s, size_t maxLen, uint64_t seed);
+
+	public:
+		CEntryIndex();
+		~CEntryIndex();
+
+		void clear();
+		void reserve(size_t count) { keys.reserve(count); }
+		uint64_t key(TStrView channel, int32_t date_unix, TStrView theme, TStrView title);
+		void add(uint64_t key_, uint32_t id);
+		void remove(uint64_t key_) { keys.erase(key_); }
+		uint32_t find(uint64_t key_);
+
+		size_t size() const { return keys.size(); }
+		void setLoadTime(double ms) { loadMs = ms; }
+		string getStats() const;
+};
+
+#endif // __ENTRYINDEX_H__
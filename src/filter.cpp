@@ -0,0 +1,190 @@
+/*
+	mv2mariadb - convert MediathekView db to mariadb
+	Copyright (C) 2015-2017, M. Liebmann 'micha-bbg'
+
+	License: GPL
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public
+	License as published by the Free Software Foundation; either
+	version 2 of the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public
+	License along with this program; if not, write to the
+	Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+	Boston, MA  02110-1301, USA.
+*/
+
+#include <stdio.h>
+
+#include <sstream>
+
+#include "filter.h"
+#include "common/helpers.h"
+
+CEntryFilter::CEntryFilter()
+{
+	channelPool = NULL;
+	themePool   = NULL;
+	minDate     = 0;
+	minDuration = 0;
+	for (int i = 0; i < filter_count; i++) {
+		active[i]  = false;
+		dropped[i] = 0;
+	}
+}
+
+CEntryFilter::~CEntryFilter()
+{
+}
+
+vector<string> CEntryFilter::splitList(const string& list)
+{
+	vector<string> ret;
+	vector<string> v = split(list, ',');
+	for (size_t i = 0; i < v.size(); i++) {
+		string s = trim(v[i]);
+		if (!s.empty())
+			ret.push_back(str_tolower(s));
+	}
+	return ret;
+}
+
+bool CEntryFilter::setupRegex(regex& re, const string& pattern, const char* name)
+{
+	if (pattern.empty())
+		return false;
+	try {
+		re.assign(pattern, regex::ECMAScript | regex::icase | regex::optimize);
+	}
+	catch (regex_error const& e) {
+		printf("[%s:%d] invalid %s \"%s\" (%s), filter disabled\n", __func__, __LINE__, name, pattern.c_str(), e.what());
+		return false;
+	}
+	return true;
+}
+
+void CEntryFilter::setup(GSettings* settings, int epoch, time_t nowTime, CStringPool* channelPool_, CStringPool* themePool_)
+{
+	channelPool = channelPool_;
+	themePool   = themePool_;
+
+	active[filter_epoch] = (epoch > 0);
+	minDate = nowTime - static_cast<time_t>(24*3600) * epoch;
+
+	channelInclude = splitList(settings->filterChannelInclude);
+	channelExclude = splitList(settings->filterChannelExclude);
+	active[filter_channel] = (!channelInclude.empty() || !channelExclude.empty());
+	channelVerdict.clear();
+
+	minDuration = settings->filterMinDuration;
+	active[filter_duration] = (minDuration > 0);
+
+	geo = settings->filterGeo;
+	geo = str_toupper(trim(geo));
+	active[filter_geo] = !geo.empty();
+
+	active[filter_theme] = setupRegex(themeRegex, settings->filterThemeRegex, "filterThemeRegex");
+	themeVerdict.clear();
+	active[filter_title] = setupRegex(titleRegex, settings->filterTitleRegex, "filterTitleRegex");
+
+	for (int i = 0; i < filter_count; i++)
+		dropped[i] = 0;
+}
+
+bool CEntryFilter::channelAllowed(uint32_t channelId)
+{
+	string channel = str_tolower(channelPool->str(channelId).str());
+	if (!channelInclude.empty() && (find(channelInclude.begin(), channelInclude.end(), channel) == channelInclude.end()))
+		return false;
+	if (find(channelExclude.begin(), channelExclude.end(), channel) != channelExclude.end())
+		return false;
+	return true;
+}
+
+bool CEntryFilter::checkChannel(uint32_t channelId)
+{
+	if (!active[filter_channel])
+		return true;
+	if (channelId >= channelVerdict.size())
+		channelVerdict.resize(channelId + 1, verdict_unknown);
+	if (channelVerdict[channelId] == verdict_unknown)
+		channelVerdict[channelId] = channelAllowed(channelId) ? verdict_keep : verdict_drop;
+	return (channelVerdict[channelId] == verdict_keep) ? true : drop(filter_channel);
+}
+
+bool CEntryFilter::checkTheme(uint32_t themeId)
+{
+	if (!active[filter_theme])
+		return true;
+	if (themeId >= themeVerdict.size())
+		themeVerdict.resize(themeId + 1, verdict_unknown);
+	if (themeVerdict[themeId] == verdict_unknown) {
+		TStrView theme = themePool->str(themeId);
+		themeVerdict[themeId] = regex_search(theme.data, theme.data + theme.len, themeRegex) ? verdict_drop : verdict_keep;
+	}
+	return (themeVerdict[themeId] == verdict_keep) ? true : drop(filter_theme);
+}
+
+bool CEntryFilter::checkTitle(const string& title)
+{
+	if (!active[filter_title])
+		return true;
+	return regex_search(title, titleRegex) ? drop(filter_title) : true;
+}
+
+bool CEntryFilter::checkDuration(int duration)
+{
+	/* unknown duration (0) is kept, e.g. livestreams */
+	if (!active[filter_duration] || (duration <= 0))
+		return true;
+	return (duration < minDuration) ? drop(filter_duration) : true;
+}
+
+bool CEntryFilter::checkDate(int date_unix)
+{
+	/* Not older than 'epoch' days (default all data) */
+	if (!active[filter_epoch] || (date_unix <= 0))
+		return true;
+	return (date_unix < minDate) ? drop(filter_epoch) : true;
+}
+
+bool CEntryFilter::checkGeo(const string& geo_)
+{
+	/* format: "DE-AT-CH", empty = no restriction */
+	if (!active[filter_geo] || geo_.empty())
+		return true;
+	vector<string> v = split(geo_, '-');
+	for (size_t i = 0; i < v.size(); i++) {
+		if (str_toupper(v[i]) == geo)
+			return true;
+	}
+	return drop(filter_geo);
+}
+
+uint32_t CEntryFilter::droppedEntries() const
+{
+	uint32_t ret = 0;
+	for (int i = 0; i < filter_count; i++)
+		ret += dropped[i];
+	return ret;
+}
+
+string CEntryFilter::getStats() const
+{
+	static const char* names[filter_count] = { "epoch", "channel", "duration", "geo", "theme", "title" };
+	ostringstream ret;
+	bool first = true;
+	for (int i = 0; i < filter_count; i++) {
+		if (!active[i])
+			continue;
+		ret << (first ? "" : ", ") << names[i] << " " << dropped[i];
+		first = false;
+	}
+	return ret.str();
+}
@@ -0,0 +1,101 @@
+/*
+	mv2mariadb - convert MediathekView db to mariadb
+	Copyright (C) 2015-2017, M. Liebmann 'micha-bbg'
+
+	License: GPL
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public
+	License as published by the Free Software Foundation; either
+	version 2 of the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public
+	License along with this program; if not, write to the
+	Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+	Boston, MA  02110-1301, USA.
+*/
+
+#ifndef __FILTER_H__
+#define __FILTER_H__
+
+#include <stdint.h>
+#include <time.h>
+
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "common/stringpool.h"
+#include "types.h"
+
+using namespace std;
+
+/* Entry filters, configured in mv2mariadb.conf. Each check runs on a
+ * single raw field as soon as the parser delivered it, a failing
+ * check drops the entry before it is materialised. Verdicts for
+ * channels and themes are cached per pool id. */
+class CEntryFilter
+{
+	public:
+		enum {
+			filter_epoch,
+			filter_channel,
+			filter_duration,
+			filter_geo,
+			filter_theme,
+			filter_title,
+			filter_count
+		};
+
+	private:
+		enum {
+			verdict_unknown,
+			verdict_keep,
+			verdict_drop
+		};
+
+		CStringPool* channelPool;
+		CStringPool* themePool;
+
+		bool     active[filter_count];
+		uint32_t dropped[filter_count];
+
+		time_t minDate;
+		int    minDuration;
+		vector<string> channelInclude;
+		vector<string> channelExclude;
+		vector<uint8_t> channelVerdict;
+		string geo;
+		regex  themeRegex;
+		regex  titleRegex;
+		vector<uint8_t> themeVerdict;
+
+		bool drop(int filter) { dropped[filter]++; return false; }
+		static vector<string> splitList(const string& list);
+		bool setupRegex(regex& re, const string& pattern, const char* name);
+		bool channelAllowed(uint32_t channelId);
+
+	public:
+		CEntryFilter();
+		~CEntryFilter();
+
+		void setup(GSettings* settings, int epoch, time_t nowTime, CStringPool* channelPool_, CStringPool* themePool_);
+
+		/* false = drop the entry */
+		bool checkChannel(uint32_t channelId);
+		bool checkTheme(uint32_t themeId);
+		bool checkTitle(const string& title);
+		bool checkDuration(int duration);
+		bool checkDate(int date_unix);
+		bool checkGeo(const string& geo_);
+
+		uint32_t droppedEntries() const;
+		string getStats() const;
+};
+
+#endif // __FILTER_H__
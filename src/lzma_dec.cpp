@@ -16,7 +16,7 @@
 
 #include "lzma_dec.h"
 
-extern void myExit(int val);
+[[noreturn]] extern void myExit(int val);
 
 CLZMAdec::CLZMAdec()
 {
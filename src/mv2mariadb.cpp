@@ -55,6 +55,8 @@
 #include "lzma_dec.h"
 #include "curl.h"
 #include "serverlist.h"
+#include "sqlwriter.h"
+#include "channelstats.h"
 
 CMV2Mysql*		g_mainInstance;
 GSettings		g_settings;
@@ -67,8 +69,10 @@ string			g_mvVersion;
 time_t			g_mvDate;
 string			g_passwordFile;
 string			g_mysqlHost;
+CStringPool		g_channelPool;
+CStringPool		g_themePool;
 
-void myExit(int val);
+[[noreturn]] void myExit(int val);
 
 string msgHead(string deb/*=""*/)
 {
@@ -112,27 +116,33 @@ void CMV2Mysql::Init()
 	g_mvDate		= time(0);
 	nowTime			= time(0);
 	csql			= NULL;
+	videoBatch		= NULL;
+	newEntriesInBatch	= 0;
 	convertData		= true;
 	forceConvertData	= false;
 	dlSegmentSize		= 8192;
 	diffMode		= diffMode_none;
 	insertEntries		= 0;
+	nkeyMode		= false;
+	stagingMode		= false;
+	nkeyDuplicates		= 0;
+	diffLastId		= 0;
+	diffNextId		= 0;
 
 	count_parser		= 0;
 	keyCount_parser		= 0;
-	videoInfoEntry.latest	= INT_MIN;
-	videoInfoEntry.oldest	= INT_MAX;
 	movieEntries		= 0;
 	movieEntriesCounter	= 0;
 	skippedUrls		= 0;
-	cName			= "";
-	tName			= "";
-	videoEntrySqlBuf	= "";
-	cCount			= 0;
-	writeLen		= 0;
-	writeStart		= true;
-	maxWriteLen		= 1048576-4096;	/* 1MB */
-//	maxWriteLen		= 524288;	/* 512KB */
+	invalidUrlPrefixes	= 0;
+	entryDropped		= false;
+	entryDuration		= 0;
+	entryDate		= 0;
+	cNameId			= 0;
+	writerPool		= NULL;
+	writerPoolSize		= 0;
+	writerPoolTime		= 0;
+	tNameId			= 0;
 	dbVersionInfoCount	= 0;
 
 
@@ -158,6 +168,14 @@ CMV2Mysql::~CMV2Mysql()
 	unlink(configFileName.c_str());
 	saveSetup(configFileName, true);
 	videoInfo.clear();
+	if (writerPool != NULL)
+		delete writerPool;
+	if (videoBatch != NULL)
+		delete videoBatch;
+	for (size_t i = 0; i < videoBatchesNew.size(); i++)
+		delete videoBatchesNew[i];
+	for (size_t i = 0; i < videoBatchesFree.size(); i++)
+		delete videoBatchesFree[i];
 	if (csql != NULL)
 		delete csql;
 }
@@ -192,6 +210,21 @@ int CMV2Mysql::loadSetup(string fname)
 	g_settings.videoDb_TableInfo		= configFile.getString("videoDb_TableInfo",        "channelinfo");
 	g_settings.videoDb_TableVersion		= configFile.getString("videoDb_TableVersion",     "version");
 	g_settings.mysqlHost			= configFile.getString("mysqlHost",                "db");
+	g_settings.mysqlPort			= configFile.getInt32 ("mysqlPort",                3306);
+	g_settings.mysqlSocket			= configFile.getString("mysqlSocket",              "");
+	g_settings.mysqlCompress		= configFile.getBool  ("mysqlCompress",            false);
+	g_settings.videoInsertMode		= configFile.getInt32 ("videoInsertMode",          1);
+	g_settings.sqlWriterConnections		= configFile.getInt32 ("sqlWriterConnections",     1);
+	g_settings.sqlRetries			= configFile.getInt32 ("sqlRetries",               3);
+	g_settings.sqlStatementSize		= configFile.getInt32 ("sqlStatementSize",         1020);
+	g_settings.sqlStatementSizeMax		= configFile.getInt32 ("sqlStatementSizeMax",      16384);
+	g_settings.sqlStatementLatency		= configFile.getInt32 ("sqlStatementLatency",      500);
+	g_settings.indexSinglePass		= configFile.getBool  ("indexSinglePass",          true);
+	g_settings.indexAlgorithm		= configFile.getString("indexAlgorithm",           "INPLACE");
+	g_settings.indexLock			= configFile.getString("indexLock",                "SHARED");
+	g_settings.indexRebuildRatio		= configFile.getInt32 ("indexRebuildRatio",        20);
+	g_settings.diffMergeMode		= configFile.getInt32 ("diffMergeMode",            0);
+	g_settings.importSessionProfile		= configFile.getString("importSessionProfile",     "unique_checks=0;foreign_key_checks=0;sql_log_bin=0;bulk_insert_buffer_size=268435456;innodb_lock_wait_timeout=600");
 	VIDEO_DB_TMP_1				= g_settings.videoDbTmp1;
 	VIDEO_DB				= g_settings.videoDb;
 	if (g_settings.testMode) {
@@ -205,6 +238,19 @@ int CMV2Mysql::loadSetup(string fname)
 	/* password file */
 	g_settings.passwordFile		= configFile.getString("passwordFile",         "pw_mariadb");
 
+	/* filter */
+	g_settings.filterEpoch		= configFile.getInt32 ("filterEpoch",          0);
+	g_settings.filterChannelInclude	= configFile.getString("filterChannelInclude", "");
+	g_settings.filterChannelExclude	= configFile.getString("filterChannelExclude", "");
+	g_settings.filterMinDuration	= configFile.getInt32 ("filterMinDuration",    0);
+	g_settings.filterGeo		= configFile.getString("filterGeo",            "");
+	g_settings.filterThemeRegex	= configFile.getString("filterThemeRegex",     "");
+	g_settings.filterTitleRegex	= configFile.getString("filterTitleRegex",     "");
+
+	/* url deduplication */
+	g_settings.urlDedup		= configFile.getInt32 ("urlDedup",             0);
+	g_settings.urlDedupMaxKeys	= configFile.getInt32 ("urlDedupMaxKeys",      2000000);
+
 	/* server list */
 	g_settings.serverListUrl	 = configFile.getString("serverListUrl",               "https://res.mediathekview.de/akt.xml");
 	g_settings.serverListLastRefresh = (time_t)configFile.getInt64("serverListLastRefresh", 0);
@@ -230,6 +276,21 @@ void CMV2Mysql::saveSetup(string fname, bool quiet/*=false*/)
 	configFile.setString("videoDb_TableInfo",        g_settings.videoDb_TableInfo);
 	configFile.setString("videoDb_TableVersion",     g_settings.videoDb_TableVersion);
 	configFile.setString("mysqlHost",                g_settings.mysqlHost);
+	configFile.setInt32 ("mysqlPort",                g_settings.mysqlPort);
+	configFile.setString("mysqlSocket",              g_settings.mysqlSocket);
+	configFile.setBool  ("mysqlCompress",            g_settings.mysqlCompress);
+	configFile.setInt32 ("videoInsertMode",          g_settings.videoInsertMode);
+	configFile.setInt32 ("sqlWriterConnections",     g_settings.sqlWriterConnections);
+	configFile.setInt32 ("sqlRetries",               g_settings.sqlRetries);
+	configFile.setInt32 ("sqlStatementSize",         g_settings.sqlStatementSize);
+	configFile.setInt32 ("sqlStatementSizeMax",      g_settings.sqlStatementSizeMax);
+	configFile.setInt32 ("sqlStatementLatency",      g_settings.sqlStatementLatency);
+	configFile.setBool  ("indexSinglePass",          g_settings.indexSinglePass);
+	configFile.setString("indexAlgorithm",           g_settings.indexAlgorithm);
+	configFile.setString("indexLock",                g_settings.indexLock);
+	configFile.setInt32 ("indexRebuildRatio",        g_settings.indexRebuildRatio);
+	configFile.setInt32 ("diffMergeMode",            g_settings.diffMergeMode);
+	configFile.setString("importSessionProfile",     g_settings.importSessionProfile);
 
 	/* download server */
 	saveDownloadServerSetup();
@@ -237,6 +298,19 @@ void CMV2Mysql::saveSetup(string fname, bool quiet/*=false*/)
 	/* password file */
 	configFile.setString("passwordFile",         g_settings.passwordFile);
 
+	/* filter */
+	configFile.setInt32 ("filterEpoch",          g_settings.filterEpoch);
+	configFile.setString("filterChannelInclude", g_settings.filterChannelInclude);
+	configFile.setString("filterChannelExclude", g_settings.filterChannelExclude);
+	configFile.setInt32 ("filterMinDuration",    g_settings.filterMinDuration);
+	configFile.setString("filterGeo",            g_settings.filterGeo);
+	configFile.setString("filterThemeRegex",     g_settings.filterThemeRegex);
+	configFile.setString("filterTitleRegex",     g_settings.filterTitleRegex);
+
+	/* url deduplication */
+	configFile.setInt32 ("urlDedup",             g_settings.urlDedup);
+	configFile.setInt32 ("urlDedupMaxKeys",      g_settings.urlDedupMaxKeys);
+
 	/* server list */
 	configFile.setString("serverListUrl",         g_settings.serverListUrl);
 	configFile.setInt64 ("serverListLastRefresh", (int64_t)(g_settings.serverListLastRefresh));
@@ -298,7 +372,7 @@ void CMV2Mysql::printHelp()
 	printHeader();
 	printCopyright();
 	printf("  -e | --epoch xxx	 => Use not older entrys than 'xxx' days\n");
-	printf("			    (default all data)\n");
+	printf("			    (default 'filterEpoch' from config, all data)\n");
 	printf("  -f | --force-convert	 => Data also convert, when\n");
 	printf("			    movie list is up-to-date.\n");
 	printf("  -c | --cron-mode xxx	 => 'xxx' = time in minutes. Specifies the period during\n");
@@ -318,6 +392,8 @@ void CMV2Mysql::printHelp()
 	printf("			    to sql database).\n");
 	printf("       --load-serverlist => Load new serverlist and exit.\n");
 	printf("       --debug-channels => Dump channel mapping for pattern (debug)\n");
+	printf("       --transport-bench => Compare tcp / socket and compression\n");
+	printf("			    with rows of the video table, then exit.\n");
 
 	printf("\n");
 	printf("  -d | --debug-print	 => Print debug info\n");
@@ -384,13 +460,14 @@ int CMV2Mysql::run(int argc, char *argv[])
 		{"download-only",	noParam,       NULL, '2'},
 		{"load-serverlist",	noParam,       NULL, '3'},
 		{"debug-channels",	requiredParam, NULL, 'p'},
+		{"transport-bench",	noParam,       NULL, '4'},
 		{"debug-print",		noParam,       NULL, 'd'},
 		{"version",		noParam,       NULL, 'v'},
 		{"help",		noParam,       NULL, 'h'},
 		{NULL,			0,             NULL,  0 }
 	};
 	int c, opt;
-	while ((opt = getopt_long(argc, argv, "e:fc:CD:n123p:dvh?", long_options, &c)) >= 0) {
+	while ((opt = getopt_long(argc, argv, "e:fc:CD:n1234p:dvh?", long_options, &c)) >= 0) {
 		switch (opt) {
 			case 'e':
 				/* >=0 and <=24800 */
@@ -426,6 +503,9 @@ int CMV2Mysql::run(int argc, char *argv[])
 			case '3':
 				loadServerlist = true;
 				break;
+			case '4':
+				csql->connectMysql();
+				return (csql->transportBench()) ? 0 : 1;
 			case 'p':
 				debugChannelPattern = static_cast<string>(optarg);
 				break;
@@ -445,6 +525,11 @@ int CMV2Mysql::run(int argc, char *argv[])
 		}
 	}
 
+	if (epoch == 0)
+		epoch = max(min(g_settings.filterEpoch, 24800), 0);
+	entryFilter.setup(&g_settings, epoch, nowTime, &g_channelPool, &g_themePool);
+	urlDedup.setup(g_settings.urlDedup, max(g_settings.urlDedupMaxKeys, 0));
+
 	if (diffMode > diffMode_none)
 		checkDiffMode();
 
@@ -751,9 +836,104 @@ double CMV2Mysql::getTimer_double(double startTime)
 	return ((workDTms - startTime) / 1000ULL);
 }
 
+CVideoBatch* CMV2Mysql::getFreeBatch()
+{
+	if (writerPool != NULL) {
+		CVideoBatch* batch = writerPool->getWrittenBatch();
+		if (batch != NULL)
+			return batch;
+	}
+	if (videoBatchesFree.empty())
+		return new CVideoBatch(videoBatchSize);
+	CVideoBatch* batch = videoBatchesFree.back();
+	videoBatchesFree.pop_back();
+	return batch;
+}
+
+void CMV2Mysql::finishVideoBatch()
+{
+	/* Diff mode: with the nkey column all rows are upserted by their
+	   natural key. Without it only the updates are written here, new
+	   entries are inserted later by insertNewEntries(). */
+	int rows  = CSql::rows_all;
+	int write = (videoBatch->replaceRows) ? CSql::write_replace : CSql::write_insert;
+	if (stagingMode)
+		write = CSql::write_replace;	/* nkey unique, the last copy wins */
+	else if ((diffMode > diffMode_none) && nkeyMode)
+		write = CSql::write_upsert;
+	else if (diffMode > diffMode_none) {
+		rows  = CSql::rows_update;
+		write = CSql::write_replace;
+	}
+	/* keep the whole batch, no copy of the entries */
+	bool keep = (newEntriesInBatch > 0);
+
+	if (writerPool != NULL) {
+		if (!videoBatch->empty()) {
+			writerPool->submit(videoBatch, rows, write, keep);
+			if (keep)
+				videoBatchesNew.push_back(videoBatch);
+			videoBatch = getFreeBatch();
+		}
+	}
+	else {
+		csql->writeVideoBatch(videoBatch, rows, write);
+		if (keep) {
+			videoBatchesNew.push_back(videoBatch);
+			videoBatch = getFreeBatch();
+		}
+		else
+			videoBatch->reset();
+	}
+	newEntriesInBatch = 0;
+}
+
+TStrView CMV2Mysql::primaryUrl(size_t row)
+{
+	static const int cols[] = { CVideoBatch::col_url, CVideoBatch::col_url_hd, CVideoBatch::col_url_small };
+	for (size_t i = 0; i < sizeof(cols)/sizeof(cols[0]); i++) {
+		TStrView url = videoBatch->str(cols[i], row);
+		if (!url.empty())
+			return url;
+	}
+	return videoBatch->str(CVideoBatch::col_url_rtmp, row);
+}
+
+bool CMV2Mysql::parseEntryField(int field, const string& data)
+{
+	switch (field) {
+		case 0: {	/* channel, empty = same as previous entry */
+			uint32_t channelId = g_channelPool.intern(data);
+			if (channelId != 0)
+				cNameId = channelId;
+			return entryFilter.checkChannel(cNameId);
+		}
+		case 1: {	/* theme, empty = same as previous entry */
+			uint32_t themeId = g_themePool.intern(data);
+			if (themeId != 0)
+				tNameId = themeId;
+			return (!entryDropped && entryFilter.checkTheme(tNameId));
+		}
+		case 2:		/* title */
+			return entryFilter.checkTitle(data);
+		case 5:		/* duration */
+			entryDuration = duration2time(data);
+			return entryFilter.checkDuration(entryDuration);
+		case 16:	/* date_unix, fallback date + time */
+			entryDate = atoi(data.c_str());
+			if ((entryDate == 0) && (movieEntry.el[3].entry != "") && (movieEntry.el[4].entry != "")) {
+				entryDate = str2time("%d.%m.%Y %H:%M:%S", movieEntry.el[3].entry + " " + movieEntry.el[4].entry);
+			}
+			return entryFilter.checkDate(entryDate);
+		case 18:	/* geo */
+			return entryFilter.checkGeo(data);
+		default:
+			return true;
+	}
+}
+
 bool CMV2Mysql::readEntry(int index)
 {
-	static bool replaceEntry = false;
 	if (index == 0) {		/* "Filmliste" 0 */
 		string tmp  = list0Entry.el[1].asString();
 		g_mvDate    = str2time("%d.%m.%Y, %H:%M", tmp);
@@ -761,69 +941,93 @@ bool CMV2Mysql::readEntry(int index)
 	} else if (index == 1) {	/* "Filmliste" 1 */
 		/* Not currently used */
 	} else {			/* "X" (data)    */
-		TVideoEntry videoEntry;
-		videoEntry.replaceID = 0;
-		videoEntry.update = 0;
-		videoEntry.channel = movieEntry.el[0].asString();
-		if ((videoEntry.channel != "") && (videoEntry.channel != cName)) {
-			if (cName != "") {
-				videoInfo.push_back(videoInfoEntry);
-			}
-			cName = videoEntry.channel;
-			cCount = 0;
-			videoInfoEntry.latest = INT_MIN;
-			videoInfoEntry.oldest = INT_MAX;
-		}
+		/* dropped by a filter in parseEntryField() */
+		if (entryDropped)
+			return true;
 
-		videoEntry.theme		= movieEntry.el[1].asString();
-		if (videoEntry.theme != "") {
-			tName = videoEntry.theme;
-		} else
-			videoEntry.theme	= tName;
-
-		videoEntry.title		= movieEntry.el[2].asString();
-		videoEntry.duration		= duration2time(movieEntry.el[5].asString());
-		videoEntry.size_mb		= movieEntry.el[6].asInt();
-		videoEntry.description		= movieEntry.el[7].asString();
-		videoEntry.url			= movieEntry.el[8].asString();
-		videoEntry.website		= movieEntry.el[9].asString();
-		videoEntry.subtitle		= movieEntry.el[10].asString();
-		videoEntry.url_rtmp		= convertUrl(videoEntry.url, movieEntry.el[11].asString());
-		videoEntry.url_small		= convertUrl(videoEntry.url, movieEntry.el[12].asString());
-		videoEntry.url_rtmp_small	= convertUrl(videoEntry.url, movieEntry.el[13].asString());
-		videoEntry.url_hd		= convertUrl(videoEntry.url, movieEntry.el[14].asString());
-		videoEntry.url_rtmp_hd		= convertUrl(videoEntry.url, movieEntry.el[15].asString());
-
-		if ((videoEntry.url.empty())	    &&
-				(videoEntry.url_rtmp.empty())       &&
-				(videoEntry.url_small.empty())      &&
-				(videoEntry.url_rtmp_small.empty()) &&
-				(videoEntry.url_hd.empty())	 &&
-				(videoEntry.url_rtmp_hd.empty())) {
+		size_t row = videoBatch->size();
+		videoBatch->setString(CVideoBatch::col_title,		movieEntry.el[2].entry);
+		videoBatch->setString(CVideoBatch::col_description,	movieEntry.el[7].entry);
+		videoBatch->setString(CVideoBatch::col_url,		movieEntry.el[8].entry);
+		videoBatch->setString(CVideoBatch::col_website,	movieEntry.el[9].entry);
+		videoBatch->setString(CVideoBatch::col_subtitle,	movieEntry.el[10].entry);
+		TStrView url = videoBatch->str(CVideoBatch::col_url, row);
+		bool hasUrl  = !url.empty();
+		hasUrl |= convertUrl(CVideoBatch::col_url_rtmp,	url, movieEntry.el[11].entry);
+		hasUrl |= convertUrl(CVideoBatch::col_url_small,	url, movieEntry.el[12].entry);
+		hasUrl |= convertUrl(CVideoBatch::col_url_rtmp_small,	url, movieEntry.el[13].entry);
+		hasUrl |= convertUrl(CVideoBatch::col_url_hd,		url, movieEntry.el[14].entry);
+		hasUrl |= convertUrl(CVideoBatch::col_url_rtmp_hd,	url, movieEntry.el[15].entry);
+		videoBatch->setString(CVideoBatch::col_url_history,	movieEntry.el[17].entry);
+		videoBatch->setString(CVideoBatch::col_geo,		movieEntry.el[18].entry);
+
+		if (!hasUrl) {
+			videoBatch->abortRow();
 			skippedUrls++;
 			return true;
 		}
 
-		videoEntry.date_unix		= movieEntry.el[16].asInt();
-		if ((videoEntry.date_unix == 0) && (movieEntry.el[3].asString() != "") && (movieEntry.el[4].asString() != "")) {
-			videoEntry.date_unix = str2time("%d.%m.%Y %H:%M:%S", movieEntry.el[3].asString() + " " + movieEntry.el[4].asString());
+		videoBatch->id[row]		= 0;
+		videoBatch->channelId[row]	= cNameId;
+		videoBatch->themeId[row]	= tNameId;
+		videoBatch->duration[row]	= entryDuration;
+		videoBatch->size_mb[row]	= movieEntry.el[6].asInt();
+		videoBatch->date_unix[row]	= entryDate;
+		videoBatch->new_entry[row]	= movieEntry.el[19].asBool();
+		videoBatch->update[row]		= 0;
+		videoBatch->insertRow[row]	= 0;
+		videoBatch->nkey[row]		= entryIndex.key(g_channelPool.str(cNameId), entryDate, g_themePool.str(tNameId),
+								 videoBatch->str(CVideoBatch::col_title, row));
+
+		/* full import: nkey is unique, the first copy is kept */
+		if ((diffMode == diffMode_none) && (entryIndex.find(videoBatch->nkey[row]) > 0)) {
+			videoBatch->abortRow();
+			nkeyDuplicates++;
+			return true;
 		}
-		if ((videoEntry.date_unix > 0) && (epoch > 0)) {
-			time_t maxDiff = (24*3600) * epoch; /* Not older than 'epoch' days (default all data) */
-			if (videoEntry.date_unix < (nowTime - maxDiff))
+
+		CUrlDedup::urlKey_t prevKey;
+		int dedup = CUrlDedup::result_new;
+		if (urlDedup.enabled()) {
+			dedup = urlDedup.check(primaryUrl(row), entryDate, &prevKey);
+			if (dedup == CUrlDedup::result_drop) {
+				videoBatch->abortRow();
 				return true;
+			}
+		}
+		addChannelStat(videoInfo, cNameId, entryDate);
+
+		uint64_t nkey = videoBatch->nkey[row];
+		if ((dedup == CUrlDedup::result_replace) && (diffMode > diffMode_none) && nkeyMode) {
+			/* The ids are placeholders here, the row of the older copy
+			   is only known by its natural key: it is deleted after the
+			   writes (deleteNaturalKeys()), unless a later entry has
+			   that key again. This entry is written as a new one. */
+			removeChannelStat(videoInfo, prevKey.channelId);
+			if (prevKey.nkey != nkey)
+				replacedKeys.insert(prevKey.nkey);
+			dedup = CUrlDedup::result_new;
+		}
+		replacedKeys.erase(nkey);
+
+		if (dedup == CUrlDedup::result_replace) {
+			/* overwrite the older copy, that row may
+			   already be written, so use REPLACE */
+			removeChannelStat(videoInfo, prevKey.channelId);
+			videoBatch->id[row]     = prevKey.id;
+			videoBatch->update[row] = (diffMode > diffMode_none) ? nowTime : 0;
+			videoBatch->replaceRows = true;
+			urlDedup.record(prevKey.id, entryDate, cNameId, nkey);
+			if (diffMode == diffMode_none) {
+				/* the row of the older copy is gone with its key */
+				entryIndex.remove(prevKey.nkey);
+				entryIndex.add(nkey, prevKey.id);
+			}
+			videoBatch->commitRow();
+			if (videoBatch->full())
+				finishVideoBatch();
+			return true;
 		}
-
-		videoEntry.url_history		= movieEntry.el[17].asString();
-		videoEntry.geo			= movieEntry.el[18].asString();
-		videoEntry.new_entry		= movieEntry.el[19].asBool();
-		videoEntry.channel		= cName;
-		cCount++;
-		videoInfoEntry.channel		= cName;
-		videoInfoEntry.count		= cCount;
-		videoInfoEntry.latest		= max(videoEntry.date_unix, videoInfoEntry.latest);
-		if (videoEntry.date_unix != 0)
-			videoInfoEntry.oldest	= min(videoEntry.date_unix, videoInfoEntry.oldest);
 
 		movieEntries++;
 		if (diffMode > diffMode_none)
@@ -838,34 +1042,39 @@ bool CMV2Mysql::readEntry(int index)
 			if ((movieEntries % 32*8) == 0)
 				cout.flush();
 		}
-		
-		uint32_t entryIdx = movieEntries;
-		if (diffMode > diffMode_none) {
-			uint32_t id_ = csql->checkEntryForUpdate(&videoEntry);
+
+		videoBatch->id[row] = movieEntries;
+		if (diffMode == diffMode_none)
+			entryIndex.add(videoBatch->nkey[row], movieEntries);
+		else if (nkeyMode) {
+			/* upsert, a new id only for a row that is inserted,
+			   a later entry with the same key updates that row */
+			uint32_t id_ = entryIndex.find(nkey);
+			if (id_ == 0) {
+				id_ = ++diffNextId;
+				entryIndex.add(nkey, id_);
+			}
+			videoBatch->id[row]     = id_;
+			videoBatch->update[row] = nowTime;
+		}
+		else {
+			uint32_t id_ = entryIndex.find(videoBatch->nkey[row]);
 			if (id_ > 0) {
-				entryIdx = id_;
-				replaceEntry = true;
-				videoEntry.update = nowTime;
+				videoBatch->id[row] = id_;
+				videoBatch->update[row] = nowTime;
 			}
 			else {
-				// INSERT NEW
-				videoEntriesNew.push_back(videoEntry);
-				return true;
+				/* INSERT NEW, written by insertNewEntries() */
+				videoBatch->id[row] = 0;
+				videoBatch->insertRow[row] = 1;
+				newEntriesInBatch++;
 			}
 		}
+		urlDedup.record(videoBatch->id[row], entryDate, cNameId, nkey);
 
-		string vQuery = csql->createVideoTableQuery(entryIdx, writeStart, replaceEntry, &videoEntry);
-		writeStart = false;
-
-		if ((writeLen + vQuery.length()) >= maxWriteLen) {
-			videoEntrySqlBuf += ";\n";
-			csql->executeSingleQueryString(videoEntrySqlBuf);
-			vQuery = csql->createVideoTableQuery(entryIdx, true, replaceEntry, &videoEntry);
-			videoEntrySqlBuf = "";
-			writeLen = 0;
-		}
-		videoEntrySqlBuf += vQuery;
-		writeLen = videoEntrySqlBuf.length();
+		videoBatch->commitRow();
+		if (videoBatch->full())
+			finishVideoBatch();
 	}
 	return true;
 }
@@ -880,7 +1089,13 @@ void CMV2Mysql::parseCallbackInternal(int type, string data, int parseMode, CRap
 	if (parseMode == CRapidJsonSAX::parser_Work) {
 		if (type == CRapidJsonSAX::type_String) {
 			if (count_parser > 1) {		// "X"
-				movieEntry.el[keyCount_parser].entry = data;
+				/* channel and theme are always needed for the
+				   carry-forward to the following entries */
+				if ((!entryDropped) || (keyCount_parser <= 1)) {
+					movieEntry.el[keyCount_parser].entry = data;
+					if (!parseEntryField(keyCount_parser, data))
+						entryDropped = true;
+				}
 			} else if (count_parser == 0) {	// "Filmliste" 0
 				list0Entry.el[keyCount_parser].entry = data;
 			} else if (count_parser == 1) {	// "Filmliste" 1
@@ -889,6 +1104,7 @@ void CMV2Mysql::parseCallbackInternal(int type, string data, int parseMode, CRap
 			keyCount_parser++;
 		} else if (type == CRapidJsonSAX::type_StartArray) {
 			keyCount_parser = 0;
+			entryDropped = false;
 		} else if (type == CRapidJsonSAX::type_EndArray) {
 			readEntry(count_parser);
 			keyCount_parser = 0;
@@ -902,7 +1118,9 @@ bool CMV2Mysql::parseDB()
 	cout << msgHead() << "parse json db & write temporary database...";
 	cout.flush();
 
-	videoEntriesNew.clear();
+	newEntriesInBatch = 0;
+	if (videoBatch == NULL)
+		videoBatch = getFreeBatch();
 
 	/* extract movie list */
 	CLZMAdec* xzDec = new CLZMAdec();
@@ -915,9 +1133,12 @@ bool CMV2Mysql::parseDB()
 		cout << endl;
 	}
 
-	/* startup operations sql db */
-	csql->executeSingleQueryString("START TRANSACTION;");
-	csql->executeSingleQueryString("SET autocommit = 0;");
+	/* startup operations sql db, the bulk load profile
+	   only for the full import into the temporary database */
+	bool sessionProfile = ((diffMode == diffMode_none) && !g_settings.importSessionProfile.empty());
+	if (sessionProfile)
+		csql->applySessionProfile(g_settings.importSessionProfile);
+	csql->startTransaction();
 	string usedDB = (diffMode > diffMode_none) ? VIDEO_DB : VIDEO_DB_TMP_1;
 	if (diffMode == diffMode_none) {
 		csql->createVideoDbFromTemplate(usedDB);
@@ -928,8 +1149,58 @@ bool CMV2Mysql::parseDB()
 		csql->setServerMultiStatementsOff();
 	}
 
+	/* A new import database always has the nkey column (template),
+	   a diff import into a database of an older version uses the
+	   entry index and insertNewEntries() instead. */
+	nkeyMode = (diffMode == diffMode_none) || csql->columnExists(VIDEO_DB, g_settings.videoDb_TableVideo, "nkey");
+	csql->setVideoNkey(nkeyMode);
+	if (!nkeyMode)
+		cout << endl << msgHead() << "no nkey column in [" << VIDEO_DB << "], the next full import adds it";
+
+	/* diffMergeMode=1: the diff list goes into a staging table with
+	   the fastest insert path, mergeStagingTable() applies it with a
+	   few set based statements in one short transaction */
+	stagingMode = ((diffMode > diffMode_none) && nkeyMode && (g_settings.diffMergeMode == 1));
+	string writeTable = g_settings.videoDb_TableVideo;
+	if (stagingMode) {
+		writeTable = csql->getStagingTable();
+		csql->createStagingTable(VIDEO_DB);
+		csql->setVideoWriteTable(writeTable);
+	}
+
+	/* The batches are written by writer threads, parsing goes on
+	   while a batch is in flight. Diff mode and urlDedup=2 (a newer
+	   url duplicate overwrites an already written row) need the
+	   batches in order, that is one writer. 0 = write inline.
+	   A diff import into the live table is written inline, the rows,
+	   new_entry and channelinfo go into the one transaction of the
+	   main connection. */
+	int writers = max(min(g_settings.sqlWriterConnections, 32), 0);
+	if ((diffMode > diffMode_none) && !stagingMode)
+		writers = 0;
+	if ((writers > 1) && ((diffMode > diffMode_none) || (g_settings.urlDedup == CUrlDedup::policy_keepNewest))) {
+		cout << endl << msgHead() << "diff mode / urlDedup=2, using one writer connection";
+		writers = 1;
+	}
+	if (writers > 0) {
+		writerPool = new CSqlWriterPool();
+		writerPool->start(writers, usedDB, writeTable, sessionProfile, nkeyMode);
+	}
+
+	entryIndex.clear();
+	replacedKeys.clear();
 	if (diffMode > diffMode_none) {
 		movieEntries = csql->getTableEntries(VIDEO_DB, g_settings.videoDb_TableVideo);
+		/* existing rows by natural key, see readEntry() */
+		entryIndex.reserve(movieEntries);
+		if (nkeyMode) {
+			/* new rows get ids above the last one */
+			diffLastId = csql->getLastIndex(VIDEO_DB, g_settings.videoDb_TableVideo);
+			diffNextId = diffLastId;
+			csql->loadNaturalKeys(VIDEO_DB, entryIndex);
+		}
+		else
+			csql->loadEntryIndex(VIDEO_DB, entryIndex);
 	}
 
 	/* parse the movie list */
@@ -946,27 +1217,51 @@ bool CMV2Mysql::parseDB()
 	}
 
 	/* final operations sql db */
-	if (!videoEntrySqlBuf.empty()) {
-		csql->executeSingleQueryString(videoEntrySqlBuf);
-		videoEntrySqlBuf.clear();
+	finishVideoBatch();
+	if (writerPool != NULL) {
+		/* commit barrier, all rows are in usedDB afterwards */
+		writerPoolSize = writerPool->size();
+		writerPool->finish(csql, videoBatchesFree);
+		writerPoolTime = writerPool->getWallTime();
+		delete writerPool;
+		writerPool = NULL;
 	}
 
-	if ((diffMode > diffMode_none) && (!videoEntriesNew.empty())) {
+	if (stagingMode) {
+		/* a new transaction sees all rows the writers committed */
+		csql->commitTransaction();
+		csql->startTransaction();
+		csql->setVideoWriteTable(g_settings.videoDb_TableVideo);
+		csql->deleteNaturalKeys(VIDEO_DB, g_settings.videoDb_TableVideo, replacedKeys);
+		csql->deleteNaturalKeys(VIDEO_DB, csql->getStagingTable(), replacedKeys);
+		insertEntries = csql->mergeStagingTable(VIDEO_DB);
+		/* channelinfo is already up to date, only the version row follows */
+		videoInfo.clear();
+	}
+	else if ((diffMode > diffMode_none) && nkeyMode) {
+		csql->deleteNaturalKeys(VIDEO_DB, g_settings.videoDb_TableVideo, replacedKeys);
+		insertEntries = csql->markNewEntries(VIDEO_DB, diffLastId);
+	}
+	else if ((diffMode > diffMode_none) && (!videoBatchesNew.empty())) {
 		insertEntries = insertNewEntries();
 	}
+	if ((diffMode > diffMode_none) && (!stagingMode))
+		csql->refreshChannelInfo(VIDEO_DB, videoInfo);
 
 	if (multiQuery) {
 		csql->setServerMultiStatementsOn();
 	}
-	videoInfo.push_back(videoInfoEntry);
 	/* Count in the database that was actually written. In full import mode the
 	   rows still live in the temporary database and are only swapped into
 	   VIDEO_DB by renameDB() further down, so counting VIDEO_DB here yields
 	   the previous import's size - or 0 on a first run. */
-	string itq = csql->createInfoTableQuery(&videoInfo, csql->getTableEntries(usedDB, g_settings.videoDb_TableVideo), diffMode);
+	const string& itq = csql->createInfoTableQuery(&videoInfo, csql->getTableEntries(usedDB, g_settings.videoDb_TableVideo), diffMode);
 	csql->executeMultiQueryString(itq);
-	csql->executeSingleQueryString("COMMIT;");
-	csql->executeSingleQueryString("SET autocommit = 1;");
+	csql->commitTransaction();
+	if (stagingMode)
+		csql->dropStagingTable(VIDEO_DB);
+	if (sessionProfile)
+		csql->restoreSessionProfile();
 
 	if (g_debugPrint) {
 		printCursorOn();
@@ -979,16 +1274,62 @@ bool CMV2Mysql::parseDB()
 		return false;
 	}
 
+	/* full import: the indexes are built in the temporary database,
+	   the swap only ever exposes fully indexed tables */
 	if (diffMode == diffMode_none) {
+		if (createIndexes)
+			csql->createIndex(diffMode, VIDEO_DB_TMP_1);
 		csql->renameDB();
 	}
-	if (createIndexes) {
-		csql->createIndex(diffMode);
+	else if (createIndexes) {
+		/* InnoDB maintains the indexes with every written row, a
+		   rebuild only pays off when a large part of the table changed
+		   or an index is missing (earlier run with -n) */
+		uint32_t tableEntries = csql->getTableEntries(VIDEO_DB, g_settings.videoDb_TableVideo);
+		uint64_t limit = static_cast<uint64_t>(tableEntries) * max(g_settings.indexRebuildRatio, 0) / 100;
+		bool complete = csql->videoIndexesComplete(VIDEO_DB);
+		if (!complete || (movieEntriesCounter > limit))
+			csql->createIndex(diffMode, VIDEO_DB);
+		else
+			cout << msgHead() << "indexes kept (" << movieEntriesCounter << " of " << tableEntries << " rows changed)" << endl;
 	}
 
 	if (skippedUrls > 0) {
 		cout << msgHead() << "skiped entrys (no url) " << skippedUrls << endl;
 	}
+	uint64_t poolSaved = (g_channelPool.bytesReferenced() - g_channelPool.bytesStored()) +
+			     (g_themePool.bytesReferenced() - g_themePool.bytesStored());
+	cout << msgHead() << "string pool: " << g_channelPool.size()-1 << " channels, ";
+	cout << g_themePool.size()-1 << " themes (" << setprecision(3) << ((double)poolSaved/1048576);
+	cout << " MB saved)" << endl;
+	if (entryFilter.droppedEntries() > 0) {
+		cout << msgHead() << "filtered entrys " << entryFilter.droppedEntries();
+		cout << " (" << entryFilter.getStats() << ")" << endl;
+	}
+	cout << msgHead() << "video rows written: " << csql->getWriteStats() << endl;
+	cout << msgHead() << "statement size: " << csql->getWriteSizeStats() << endl;
+	cout << msgHead() << "sql round trips: " << csql->getRoundTrips() << endl;
+	if (csql->getRetries() > 0)
+		cout << msgHead() << "sql retries (reconnect, batch written again): " << csql->getRetries() << endl;
+	if (diffMode == diffMode_none)
+		cout << msgHead() << "session profile: " << csql->getSessionProfileStats() << endl;
+	if (writerPoolSize > 0) {
+		cout << msgHead() << "writer pool: " << writerPoolSize << " connections, ";
+		cout << setprecision(3) << (writerPoolTime / 1000) << " sec" << endl;
+	}
+	string utf8Stats = csql->getUtf8Stats();
+	if (!utf8Stats.empty())
+		cout << msgHead() << "utf8: " << utf8Stats << endl;
+	if (diffMode > diffMode_none)
+		cout << msgHead() << "entry index: " << entryIndex.getStats() << endl;
+	if (nkeyDuplicates > 0)
+		cout << msgHead() << "dropped entries (same channel, date, theme, title) " << nkeyDuplicates << endl;
+	if (urlDedup.enabled()) {
+		cout << msgHead() << "url dedup: " << urlDedup.getStats() << endl;
+	}
+	if (invalidUrlPrefixes > 0) {
+		cout << msgHead() << "dropped url variants (invalid prefix) " << invalidUrlPrefixes << endl;
+	}
 	string days_s = (epoch > 0) ? to_string(epoch) + " days" : "all data";
 	string parseEndTime = getTimer_str(parseStartTime, "");
 	double entryTime = (getTimer_double(parseStartTime) / movieEntriesCounter) * 1000;
@@ -1012,56 +1353,63 @@ bool CMV2Mysql::parseDB()
 size_t CMV2Mysql::insertNewEntries()
 {
 	cout << endl << msgHead() << "insert new entries...";
-	videoEntrySqlBuf.clear();
-	writeLen = 0;
 //	int entryIdx = csql->getTableEntries(VIDEO_DB, g_settings.videoDb_TableVideo);
 	int entryIdx = csql->getLastIndex(VIDEO_DB, g_settings.videoDb_TableVideo);
-	writeStart = true;
-	size_t i = 0;
-	for (i = 0; i < videoEntriesNew.size(); i++) {
-		videoEntriesNew[i].new_entry = true;
-		videoEntriesNew[i].update = nowTime;
-		entryIdx++;
-		string vQuery = csql->createVideoTableQuery(entryIdx, writeStart, false, &(videoEntriesNew[i]));
-		writeStart = false;
-
-		if ((writeLen + vQuery.length()) >= maxWriteLen) {
-			videoEntrySqlBuf += ";\n";
-			csql->executeSingleQueryString(videoEntrySqlBuf);
-			vQuery = csql->createVideoTableQuery(entryIdx, true, false, &(videoEntriesNew[i]));
-			videoEntrySqlBuf = "";
-			writeLen = 0;
+	size_t count = 0;
+	for (size_t b = 0; b < videoBatchesNew.size(); b++) {
+		CVideoBatch* batch = videoBatchesNew[b];
+		for (size_t i = 0; i < batch->size(); i++) {
+			if (!batch->insertRow[i])
+				continue;
+			entryIdx++;
+			batch->id[i]        = entryIdx;
+			batch->new_entry[i] = 1;
+			batch->update[i]    = nowTime;
+			count++;
 		}
-		videoEntrySqlBuf += vQuery;
-		writeLen = videoEntrySqlBuf.length();
-	}
-	videoEntriesNew.clear();
-	if (!videoEntrySqlBuf.empty()) {
-		csql->executeSingleQueryString(videoEntrySqlBuf);
-		videoEntrySqlBuf.clear();
+		csql->writeVideoBatch(batch, CSql::rows_insert, false);
+		batch->reset();
+		videoBatchesFree.push_back(batch);
 	}
+	videoBatchesNew.clear();
 
 	cout << "done.";
-	return i;
+	return count;
 }
 
-string CMV2Mysql::convertUrl(string url1, string url2)
+bool CMV2Mysql::convertUrl(int col, TStrView url1, const string& url2)
 {
 	/* format url_small / url_rtmp_small etc:
 		55|xxx.yyy
 		 |    |
 		 |    ----------  replace string
-		 ---------------  replace pos in videoEntry.url (url1) */
+		 ---------------  replace pos in videoEntry.url (url1)
+	   The expanded url is written directly into the batch column. */
 
-	string ret = "";
-	size_t pos = url2.find_first_of("|");
-	if (pos != string::npos) {
-		int pos1 = atoi(url2.substr(0, pos).c_str());
-		ret = url1.substr(0, pos1) + url2.substr(pos+1);
-	} else
-		ret = url2;
+	size_t pos = url2.find('|');
+	if (pos == string::npos) {
+		videoBatch->setString(col, url2);
+		return !url2.empty();
+	}
 
-	return ret;
+	size_t pos1 = 0;
+	for (size_t i = 0; i < pos; i++) {
+		char c = url2[i];
+		if ((c < '0') || (c > '9') || (pos1 > url1.len)) {
+			pos1 = string::npos;
+			break;
+		}
+		pos1 = pos1*10 + (c - '0');
+	}
+	if (pos1 > url1.len) {
+		/* Prefix doesn't fit to url1, the result would be garbage. */
+		invalidUrlPrefixes++;
+		videoBatch->setString(col, "", 0);
+		return false;
+	}
+
+	videoBatch->setString(col, url1.data, pos1, url2.data()+pos+1, url2.length()-pos-1);
+	return ((pos1 + url2.length()-pos-1) > 0);
 }
 
 const char* mySEMID = PROGNAME "_SEMID";
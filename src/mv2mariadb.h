@@ -30,11 +30,18 @@
 #include <unistd.h>
 
 #include <string>
+#include <unordered_set>
 
 #include "common/helpers.h"
 #include "common/rapidjsonsax.h"
+#include "common/strarena.h"
+#include "common/stringpool.h"
 #include "configfile.h"
+#include "dedup.h"
+#include "entryindex.h"
+#include "filter.h"
 #include "types.h"
+#include "videobatch.h"
 
 using namespace std;
 
@@ -43,9 +50,11 @@ string msgHeadDebug();
 string msgHeadFuncLine();
 
 class CSql;
+class CSqlWriterPool;
 
 #define list0Count 5
 #define movieEntryCount 20
+#define videoBatchSize 4096
 
 class CMV2Mysql
 {
@@ -74,25 +83,33 @@ class CMV2Mysql
 
 		int count_parser;
 		int keyCount_parser;
-		TVideoInfoEntry videoInfoEntry;
 		time_t nowTime;
 		uint32_t movieEntries;
 		uint32_t movieEntriesCounter;
 		uint32_t skippedUrls;
-		string videoEntrySqlBuf;
-		string cName;
-		string tName;
-		int cCount;
-		uint32_t writeLen;
-		bool writeStart;
-		uint32_t maxWriteLen;
+		uint32_t invalidUrlPrefixes;
+		CEntryFilter entryFilter;
+		CUrlDedup urlDedup;
+		CEntryIndex entryIndex;
+		bool nkeyMode;			/* the video table has the nkey column */
+		bool stagingMode;		/* diffMergeMode=1 */
+		uint32_t nkeyDuplicates;
+		uint32_t diffLastId;		/* diff mode: MAX(id) before the import */
+		uint32_t diffNextId;
+		unordered_set<uint64_t> replacedKeys;	/* diff mode: rows of replaced url duplicates */
+		bool entryDropped;
+		int entryDuration;
+		int entryDate;
+		uint32_t cNameId;
+		uint32_t tNameId;
 		string dbVersionInfo;
 		int dbVersionInfoCount;
 		size_t insertEntries;
 
 		typedef struct {
 			string entry;
-			string asString() { return entry; }
+			/* a reference, views (TStrView) into the result stay valid */
+			const string& asString() const { return entry; }
 			const char* asCString() { return entry.c_str(); }
 			int asInt() { return atoi(entry.c_str()); }
 			bool asBool() { return ((entry != "false") && (entry != "FALSE") && (entry != "0")); }
@@ -121,12 +138,18 @@ class CMV2Mysql
 		list0Entry_t list0Entry;
 		list1Entry_t list1Entry;
 		movieEntry_t movieEntry;
-		vector<TVideoEntry> videoEntriesNew;
+		CVideoBatch* videoBatch;
+		size_t newEntriesInBatch;
+		vector<CVideoBatch*> videoBatchesNew;
+		vector<CVideoBatch*> videoBatchesFree;
+		CSqlWriterPool* writerPool;
+		size_t writerPoolSize;
+		double writerPoolTime;
 
 		string	jsonDbName;
 		string	xzName;
 		string	templateDBFile;
-		vector<TVideoInfoEntry> videoInfo;
+		videoInfoMap_t videoInfo;
 		string VIDEO_DB_TMP_1;
 		string VIDEO_DB;
 		string userAgentCheck;
@@ -145,13 +168,17 @@ class CMV2Mysql
 		double startTimer();
 		string getTimer_str(double startTime, string txt, int preci=3);
 		double getTimer_double(double startTime);
+		CVideoBatch* getFreeBatch();
+		void finishVideoBatch();
+		TStrView primaryUrl(size_t row);
+		bool parseEntryField(int field, const string& data);
 		bool readEntry(int index);
 		static void verCallback(int type, string data, int parseMode, CRapidJsonSAX* instance);
 		static void parseCallback(int type, string data, int parseMode, CRapidJsonSAX* instance);
 		void parseCallbackInternal(int type, string data, int parseMode, CRapidJsonSAX* instance);
 		size_t insertNewEntries();
 		bool parseDB();
-		string convertUrl(string url1, string url2);
+		bool convertUrl(int col, TStrView url1, const string& url2);
 		void checkDiffMode();
 
 		int loadSetup(string fname);
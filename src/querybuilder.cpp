@@ -0,0 +1,71 @@
+/*
+	mv2mariadb - convert MediathekView db to mysql
+	Copyright (C) 2015-2017, M. Liebmann 'micha-bbg'
+
+	License: GPL
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public
+	License as published by the Free Software Foundation; either
+	version 2 of the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public
+	License along with this program; if not, write to the
+	Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+	Boston, MA  02110-1301, USA.
+*/
+
+#include <stdio.h>
+
+#include "querybuilder.h"
+
+CQueryBuilder::CQueryBuilder(size_t reserve/*=4096*/)
+{
+	stats    = NULL;
+	buf.reserve(reserve);
+}
+
+CQueryBuilder::~CQueryBuilder()
+{
+}
+
+CQueryBuilder& CQueryBuilder::addInt(int64_t i)
+{
+	char tmp[24];
+	int len = snprintf(tmp, sizeof(tmp), "%lld", static_cast<long long>(i));
+	buf.append(tmp, len);
+	return *this;
+}
+
+CQueryBuilder& CQueryBuilder::addUInt(uint64_t i)
+{
+	char tmp[24];
+	int len = snprintf(tmp, sizeof(tmp), "%llu", static_cast<unsigned long long>(i));
+	buf.append(tmp, len);
+	return *this;
+}
+
+CQueryBuilder& CQueryBuilder::addString(const char* data, size_t len, size_t maxLen)
+{
+	/* worst case: every byte escaped and the quotes */
+	size_t pos = buf.length();
+	buf.resize(pos + 2*min(len, maxLen) + 2);
+	buf[pos] = '\'';
+	size_t n = utf8Escape(&buf[pos+1], data, len, maxLen, utf8Esc_sql, stats);
+	buf[pos+1+n] = '\'';
+	buf.resize(pos + n + 2);
+	return *this;
+}
+
+CQueryBuilder& CQueryBuilder::addQuoted(const char* data, size_t len)
+{
+	buf += '\'';
+	buf.append(data, len);
+	buf += '\'';
+	return *this;
+}
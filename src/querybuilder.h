@@ -0,0 +1,70 @@
+/*
+	mv2mariadb - convert MediathekView db to mariadb
+	Copyright (C) 2015-2017, M. Liebmann 'micha-bbg'
+
+	License: GPL
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public
+	License as published by the Free Software Foundation; either
+	version 2 of the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public
+	License along with this program; if not, write to the
+	Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+	Boston, MA  02110-1301, USA.
+*/
+
+#ifndef __QUERYBUILDER_H__
+#define __QUERYBUILDER_H__
+
+#include <stdint.h>
+
+#include <string>
+
+#include "common/strarena.h"
+#include "common/utf8.h"
+
+using namespace std;
+
+/* Builds SQL statements in one reused buffer. String values are
+ * truncated, quoted and escaped (utf8Escape()) directly into the buffer, so there
+ * is no temporary string per field. clear() keeps the capacity. */
+class CQueryBuilder
+{
+	private:
+		TUtf8Stats* stats;
+		string buf;
+
+	public:
+		CQueryBuilder(size_t reserve = 4096);
+		~CQueryBuilder();
+
+		void setStats(TUtf8Stats* stats_) { stats = stats_; }
+		void clear() { buf.clear(); }
+		const string& str() const { return buf; }
+		size_t length() const { return buf.length(); }
+		bool empty() const { return buf.empty(); }
+
+		CQueryBuilder& add(char c) { buf += c; return *this; }
+		CQueryBuilder& add(const char* s) { buf += s; return *this; }
+		CQueryBuilder& add(const string& s) { buf += s; return *this; }
+		CQueryBuilder& addRaw(const char* data, size_t len) { buf.append(data, len); return *this; }
+		CQueryBuilder& addInt(int64_t i);
+		CQueryBuilder& addUInt(uint64_t i);
+
+		/* 'value' (escaped, at most maxLen bytes of the source, cut at
+		   a code point boundary, invalid UTF-8 replaced by '?') */
+		CQueryBuilder& addString(const char* data, size_t len, size_t maxLen);
+		CQueryBuilder& addString(const string& s, size_t maxLen) { return addString(s.data(), s.length(), maxLen); }
+		CQueryBuilder& addString(TStrView s, size_t maxLen) { return addString(s.data, s.len, maxLen); }
+		/* 'value' of an already escaped value */
+		CQueryBuilder& addQuoted(const char* data, size_t len);
+};
+
+#endif // __QUERYBUILDER_H__
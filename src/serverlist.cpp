@@ -15,7 +15,7 @@ extern GSettings	g_settings;
 extern const char*	g_progName;
 extern bool		g_debugPrint;
 
-extern void myExit(int val);
+[[noreturn]] extern void myExit(int val);
 
 CServerlist::CServerlist(string ue)
 {
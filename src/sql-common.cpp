@@ -42,10 +42,15 @@ bool CSql::databaseExists(string db)
 
 uint32_t CSql::getTableEntries(string db, string table)
 {
-	string tmpUsedDb = getUsedDatabase();
-	setUsedDatabase(db);
+	/* counted once, any write on this connection or
+	   a merge of the writer statistics forgets the counts */
+	string key = db + "." + table;
+	rowCountMap_t::iterator it = rowCounts.find(key);
+	if (it != rowCounts.end())
+		return it->second;
+
 	uint32_t ret = 0;
-        string query = "SELECT COUNT(id) AS anz FROM " + table + ";";
+	string query = "SELECT COUNT(*) FROM `" + db + "`.`" + table + "`;";
 	executeSingleQueryString(query);
 	MYSQL_RES* result = mysql_store_result(mysqlCon);
 	MYSQL_ROW row;
@@ -55,19 +60,15 @@ uint32_t CSql::getTableEntries(string db, string table)
 			ret = atoi(row[0]);
 	}
 	mysql_free_result(result);
-	
-	if ((!tmpUsedDb.empty()) && (tmpUsedDb != db))
-		setUsedDatabase(tmpUsedDb);
 
+	rowCounts[key] = ret;
 	return ret;
 }
 
 uint32_t CSql::getLastIndex(string db, string table)
 {
-	string tmpUsedDb = getUsedDatabase();
-	setUsedDatabase(db);
 	uint32_t ret = 0;
-	string query = "SELECT MAX(id) FROM " + table;
+	string query = "SELECT MAX(id) FROM `" + db + "`.`" + table + "`;";
 	executeSingleQueryString(query);
 	MYSQL_RES* result = mysql_store_result(mysqlCon);
 	MYSQL_ROW row;
@@ -77,36 +78,30 @@ uint32_t CSql::getLastIndex(string db, string table)
 			ret = atoi(row[0]);
 	}
 	mysql_free_result(result);
-	
-	if ((!tmpUsedDb.empty()) && (tmpUsedDb != db))
-		setUsedDatabase(tmpUsedDb);
 
 	return ret;
 }
 
 string CSql::getUsedDatabase()
 {
-	string ret_s = "";
-	string query = "SELECT DATABASE();";
-	executeSingleQueryString(query);
-	MYSQL_RES* result = mysql_store_result(mysqlCon);
-	MYSQL_ROW row;
-	if (mysql_num_fields(result) > 0) {
-		row = mysql_fetch_row(result);
-		if ((row != NULL) && (row[0] != NULL))
-			ret_s = (string)row[0];
-	}
-	mysql_free_result(result);
-
-	return ret_s;
+	/* tracked client side, see setUsedDatabase() */
+	return usedDB;
 }
 
 void CSql::setUsedDatabase(string db)
 {
-	if (!db.empty() && databaseExists(db)) {
-		string query = "USE " + db + ";";
-		executeSingleQueryString(query);
+	if (db.empty() || (db == usedDB))
+		return;
+	/* prepared statements are bound to the old database */
+	closeVideoStmts();
+	roundTrips++;
+	if (mysql_select_db(mysqlCon, db.c_str()) != 0) {
+		/* like before: a database that doesn't exist is ignored */
+		if (mysql_errno(mysqlCon) == ER_BAD_DB_ERROR)
+			return;
+		show_error(__func__, __LINE__);
 	}
+	usedDB = db;
 }
 
 bool CSql::copyDatabase(string fromDB, string toDB, string characterSet, bool noData/*=false*/)
@@ -119,26 +114,111 @@ bool CSql::renameDatabase(string fromDB, string toDB, string characterSet)
 	return intCopyOrRenameDatabase(fromDB, toDB, characterSet, db_mode_rename);
 }
 
-bool CSql::intCopyOrRenameDatabase(string fromDB, string toDB, string characterSet, int mode, bool noData/*=false*/)
+vector<string> CSql::getTables(string db)
 {
-	if (multiQuery)
-		setServerMultiStatementsOff();
-
-	string oldUsedDB = getUsedDatabase();
-	setUsedDatabase(fromDB);
-	string query = "SHOW TABLES;";
-	executeSingleQueryString(query);
-
 	vector<string> tablesList;
+	if (!databaseExists(db))
+		return tablesList;
+	executeSingleQueryString("SHOW TABLES FROM `" + db + "`;");
 	MYSQL_RES* result = mysql_store_result(mysqlCon);
 	MYSQL_ROW row;
 	while ((row = mysql_fetch_row(result))) {
 		tablesList.push_back((string)row[0]);
 	}
 	mysql_free_result(result);
+	return tablesList;
+}
+
+bool CSql::swapDatabase(string fromDB, string toDB, string characterSet)
+{
+	/* Live tables go to a backup database and the new ones take their
+	   place in one multi-table RENAME TABLE, which the server executes
+	   atomically: readers see either the old or the new generation. */
+	string backupDB = toDB + "_old";
+	if (multiQuery)
+		setServerMultiStatementsOff();
+	vector<string> fromTables = getTables(fromDB);
+	vector<string> toTables   = getTables(toDB);
+	waitDropDatabase();
+	if (databaseExists(backupDB)) {
+		/* left over from an interrupted run, holds a generation of
+		   ours (or nothing yet). Anything else is not ours to drop. */
+		vector<string> backupTables = getTables(backupDB);
+		if (!backupTables.empty() && (find(backupTables.begin(), backupTables.end(), VERSION_TABLE) == backupTables.end())) {
+			printf("\n[%s] database [%s] exists and was not created by %s (no table [%s]), not dropping it.\n",
+			       g_progName, backupDB.c_str(), g_progName, VERSION_TABLE.c_str());
+			printf("[%s] rename or drop it manually, the new data stays in [%s].\n", g_progName, fromDB.c_str());
+			myExit(1);
+		}
+		printf("\n[%s] dropping leftover backup database [%s] (%d tables)\n", g_progName, backupDB.c_str(), static_cast<int>(backupTables.size()));
+		executeSingleQueryString("DROP DATABASE `" + backupDB + "`;");
+	}
+	executeSingleQueryString("CREATE DATABASE `" + backupDB + "` " + characterSet + ";");
+	executeSingleQueryString("CREATE DATABASE IF NOT EXISTS `" + toDB + "` " + characterSet + ";");
+
+	string query = "RENAME TABLE ";
+	for (size_t i = 0; i < fromTables.size(); i++) {
+		if (find(toTables.begin(), toTables.end(), fromTables[i]) != toTables.end())
+			query += "`" + toDB + "`.`" + fromTables[i] + "` TO `" + backupDB + "`.`" + fromTables[i] + "`, ";
+	}
+	for (size_t i = 0; i < fromTables.size(); i++) {
+		query += "`" + fromDB + "`.`" + fromTables[i] + "` TO `" + toDB + "`.`" + fromTables[i] + "`";
+		query += (i < fromTables.size() - 1) ? ", " : ";";
+	}
+	bool ret = true;
+	if (!fromTables.empty())
+		ret = executeSingleQueryString(query);
+
+	/* fromDB is empty now, the old generation is dropped in the background */
+	executeSingleQueryString("DROP DATABASE IF EXISTS `" + fromDB + "`;");
+	if (usedDB == fromDB)
+		usedDB = "";
+	rowCounts.clear();
+	dropDatabaseAsync(backupDB);
+
 	if (multiQuery)
 		setServerMultiStatementsOn();
+	return ret;
+}
+
+void CSql::dropDatabaseWorker(string db)
+{
+	mysql_thread_init();
+	CSql* sql = new CSql();
+	try {
+		sql->throwOnError = true;
+		sql->connectMysql("drop");
+		double startMs = nowMs();
+		sql->executeSingleQueryString("DROP DATABASE IF EXISTS `" + db + "`;");
+		if (g_debugPrint)
+			printf("[%s-debug] database [%s] dropped (%.02f sec)\n", g_progName, db.c_str(), (nowMs() - startMs) / 1000);
+	}
+	catch (CSqlError const& e) {
+		printf("[%s] dropping database [%s] failed: %s", g_progName, db.c_str(), e.what());
+	}
+	delete sql;
+	mysql_thread_end();
+}
+
+void CSql::dropDatabaseAsync(string db)
+{
+	waitDropDatabase();
+	dropThread = thread(&CSql::dropDatabaseWorker, db);
+}
+
+void CSql::waitDropDatabase()
+{
+	if (dropThread.joinable())
+		dropThread.join();
+}
+
+bool CSql::intCopyOrRenameDatabase(string fromDB, string toDB, string characterSet, int mode, bool noData/*=false*/)
+{
+	if (mode == db_mode_rename)
+		return swapDatabase(fromDB, toDB, characterSet);
 
+	vector<string> tablesList = getTables(fromDB);
+	string query;
 	query = "";
 	query += "START TRANSACTION;";
 	query += "SET autocommit = 0;";
@@ -152,17 +232,166 @@ bool CSql::intCopyOrRenameDatabase(string fromDB, string toDB, string characterS
 				query += "INSERT INTO " + toDB + "." + tablesList[i] + " SELECT * FROM " + fromDB + "." + tablesList[i] + ";";
 		}
 	}
-	/* rename (move) tables */
-	else if (mode == db_mode_rename) {
-		for (size_t i = 0; i < tablesList.size(); i++) {
-			query += "RENAME TABLE " + fromDB + "." + tablesList[i] + " TO " + toDB + "." + tablesList[i] + ";";
-		}
-		query += "DROP DATABASE IF EXISTS `" + fromDB + "`;";
-	}
 	query += "COMMIT;";
 	query += "SET autocommit = 1;";
 	bool ret = executeMultiQueryString(query);
 
-	setUsedDatabase(oldUsedDB);
+	/* the server has no current database after dropping it */
+	if (usedDB == toDB)
+		usedDB = "";
+	return ret;
+}
+
+int CSql::tryQueryString(const string& query, bool freeResult/*=true*/)
+{
+	/* like executeSingleQueryString(), but a rejected statement is
+	   returned to the caller, only a lost connection is fatal */
+	roundTrips++;
+	if (mysql_real_query(mysqlCon, query.c_str(), query.length()) != 0) {
+		unsigned int err = mysql_errno(mysqlCon);
+		if ((err == CR_SERVER_GONE_ERROR) || (err == CR_SERVER_LOST))
+			show_error(__func__, __LINE__);
+		return static_cast<int>(err);
+	}
+	if (freeResult) {
+		MYSQL_RES* result = mysql_store_result(mysqlCon);
+		if (result != NULL)
+			mysql_free_result(result);
+	}
+	return 0;
+}
+
+bool CSql::getSessionVariable(const string& name, string& value)
+{
+	string query = "SELECT @@SESSION." + name + ";";
+	if (tryQueryString(query, false) != 0)
+		return false;
+	MYSQL_RES* result = mysql_store_result(mysqlCon);
+	if (result == NULL)
+		return false;
+	MYSQL_ROW row = mysql_fetch_row(result);
+	if ((row != NULL) && (row[0] != NULL))
+		value = row[0];
+	mysql_free_result(result);
+	return true;
+}
+
+static bool sessionValueValid(const string& s, bool name)
+{
+	if (s.empty())
+		return false;
+	for (size_t i = 0; i < s.length(); i++) {
+		char c = s[i];
+		if (isalnum(static_cast<unsigned char>(c)) || (c == '_'))
+			continue;
+		if (!name && ((c == '.') || (c == '-') || (c == ',')))
+			continue;
+		return false;
+	}
+	return true;
+}
+
+static string sessionValueLiteral(const string& s)
+{
+	/* numbers as is, ON/OFF and sql_mode lists as string */
+	if (s.find_first_not_of("0123456789") == string::npos)
+		return s;
+	return "'" + s + "'";
+}
+
+void CSql::applySessionProfile(const string& profile)
+{
+	sessionVars.clear();
+	profileDenied.clear();
+	vector<string> v = split(profile, ';');
+	for (size_t i = 0; i < v.size(); i++) {
+		string item = trim(v[i]);
+		size_t pos = item.find('=');
+		if (pos == string::npos)
+			continue;
+		sessionVar_t var;
+		string name  = item.substr(0, pos);
+		string value = item.substr(pos + 1);
+		var.name  = trim(name);
+		var.value = trim(value);
+		if (!sessionValueValid(var.name, true) || !sessionValueValid(var.value, false)) {
+			printf("[%s] session profile: invalid entry '%s' ignored\n", g_progName, item.c_str());
+			continue;
+		}
+
+		/* remember the session value for restoreSessionProfile(),
+		   unknown variables (other server version) are skipped */
+		if (!getSessionVariable(var.name, var.prev)) {
+			profileDenied += (profileDenied.empty() ? "" : ", ") + var.name;
+			continue;
+		}
+
+		/* e.g. sql_log_bin needs the SUPER / BINLOG ADMIN privilege */
+		int err = tryQueryString("SET SESSION " + var.name + " = " + sessionValueLiteral(var.value) + ";");
+		if (err != 0) {
+			if (g_debugPrint)
+				printf("[%s-debug] session profile: %s not applied (%s)\n", g_progName, var.name.c_str(), mysql_error(mysqlCon));
+			profileDenied += (profileDenied.empty() ? "" : ", ") + var.name;
+			continue;
+		}
+		sessionVars.push_back(var);
+	}
+}
+
+void CSql::restoreSessionProfile()
+{
+	for (size_t i = sessionVars.size(); i > 0; i--) {
+		const sessionVar_t& var = sessionVars[i-1];
+		if (!var.prev.empty())
+			tryQueryString("SET SESSION " + var.name + " = " + sessionValueLiteral(var.prev) + ";");
+	}
+	sessionVars.clear();
+}
+
+void CSql::startTransaction()
+{
+	executeSingleQueryString("START TRANSACTION;");
+	executeSingleQueryString("SET autocommit = 0;");
+	transaction = true;
+}
+
+void CSql::commitTransaction()
+{
+	executeSingleQueryString("COMMIT;");
+	executeSingleQueryString("SET autocommit = 1;");
+	transaction = false;
+}
+
+void CSql::reconnect()
+{
+	/* new connection with the session state of the lost one */
+	string db  = usedDB;
+	int  multi = multiStatements;
+	closeVideoStmts();
+	if (mysqlCon != NULL)
+		mysql_close(mysqlCon);
+	mysqlCon = NULL;
+	connectMysql(connectName);
+
+	for (size_t i = 0; i < sessionVars.size(); i++)
+		tryQueryString("SET SESSION " + sessionVars[i].name + " = " + sessionValueLiteral(sessionVars[i].value) + ";");
+	if (transaction) {
+		executeSingleQueryString("START TRANSACTION;");
+		executeSingleQueryString("SET autocommit = 0;");
+	}
+	setUsedDatabase(db);
+	if (multi == 0)
+		setServerMultiStatementsOff();
+}
+
+string CSql::getSessionProfileStats()
+{
+	string ret;
+	for (size_t i = 0; i < sessionVars.size(); i++)
+		ret += (ret.empty() ? "" : ", ") + sessionVars[i].name + "=" + sessionVars[i].value;
+	if (ret.empty())
+		ret = "none";
+	if (!profileDenied.empty())
+		ret += " (not applied: " + profileDenied + ")";
 	return ret;
 }
@@ -26,9 +26,12 @@
 #include <fcntl.h>
 #include <getopt.h>
 #include <libgen.h>
+#include <strings.h>
 
+#include <errmsg.h>
 #include <mysqld_error.h>
 
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <climits>
@@ -36,6 +39,7 @@
 #include "sql.h"
 #include "common/helpers.h"
 #include "common/filehelpers.h"
+#include "common/utf8.h"
 #include "types.h"
 
 extern GSettings		g_settings;
@@ -47,8 +51,33 @@ extern time_t			g_mvDate;
 extern bool			g_debugPrint;
 extern string			g_passwordFile;
 extern string			g_mysqlHost;
-
-extern void myExit(int val);
+extern CStringPool		g_channelPool;
+extern CStringPool		g_themePool;
+
+[[noreturn]] extern void myExit(int val);
+
+/* byte limits of the string columns in the video table */
+static const size_t videoColMaxLen[CVideoBatch::col_count] = {
+	1024,	/* title */
+	32768,	/* description */
+	1024,	/* url */
+	1024,	/* website */
+	1024,	/* subtitle */
+	1024,	/* url_rtmp */
+	1024,	/* url_small */
+	1024,	/* url_rtmp_small */
+	1024,	/* url_hd */
+	1024,	/* url_rtmp_hd */
+	1024,	/* url_history */
+	1024	/* geo */
+};
+
+static double nowMs()
+{
+	struct timeval t1;
+	gettimeofday(&t1, NULL);
+	return (double)t1.tv_sec*1000ULL + ((double)t1.tv_usec)/1000ULL;
+}
 
 CSql::CSql()
 {
@@ -70,12 +99,49 @@ void CSql::Init()
 	VERSION_TABLE			= g_settings.videoDb_TableVersion;
 
 	multiQuery			= true;
+	throwOnError			= false;
+	utf8Stats.truncated		= 0;
+	utf8Stats.repaired		= 0;
+	queryBuf.setStats(&utf8Stats);
+	videoQuery.setStats(&utf8Stats);
 	mysqlCon			= NULL;
+	videoInsertMode			= g_settings.videoInsertMode;
+	videoNkey			= false;
+	videoWriteTable			= VIDEO_TABLE;
+	videoStmt[0]			= NULL;
+	videoStmt[1]			= NULL;
+	videoStmt[2]			= NULL;
+	bulkAvailable			= false;
+	loadDataAvailable		= false;
+	infile.sql			= this;
+	infile.batch			= NULL;
+	infile.row			= 0;
+	infile.bufPos			= 0;
+	infile.bytes			= 0;
+	for (int i = 0; i < insertMode_count; i++) {
+		writeStat[i].rows	= 0;
+		writeStat[i].bytes	= 0;
+		writeStat[i].ms		= 0;
+		writeStat[i].skipped	= 0;
+		writeStat[i].warnings	= 0;
+	}
+	serverMaxPacket			= 0;
+	transportSocket			= g_settings.mysqlSocket;
+	transportPort			= g_settings.mysqlPort;
+	transportCompress		= g_settings.mysqlCompress;
+	multiStatements			= -1;
+	roundTrips			= 0;
+	retryState			= retry_none;
+	retries				= 0;
+	transaction			= false;
+	connectName			= "";
 	dbDefaultCharacterSet		= "DEFAULT CHARACTER SET utf8mb4 COLLATE utf8mb4_unicode_ci";
 }
 
 CSql::~CSql()
 {
+	waitDropDatabase();
+	closeVideoStmts();
 	if (mysqlCon != NULL) {
 		int maxAllowedPacket = 4194304;			// default
 		if (mysql_optionsv(mysqlCon, MYSQL_OPT_MAX_ALLOWED_PACKET, (const void*)(&maxAllowedPacket)) != 0)
@@ -87,18 +153,69 @@ CSql::~CSql()
 
 void CSql::show_error(const char* func, int line)
 {
-	printf("\n[%s:%d] Error(%d) [%s] \"%s\"\n",
+	char msg[1024];
+	snprintf(msg, sizeof(msg), "\n[%s:%d] Error(%d) [%s] \"%s\"\n",
 	       				    func, line,
 					    mysql_errno(mysqlCon),
 					    mysql_sqlstate(mysqlCon),
 					    mysql_error(mysqlCon));
-	mysql_close(mysqlCon);
+	fatalError(msg, mysql_errno(mysqlCon));
+}
+
+void CSql::show_stmt_error(MYSQL_STMT* stmt, const char* func, int line)
+{
+	char msg[1024];
+	snprintf(msg, sizeof(msg), "\n[%s:%d] Error(%d) [%s] \"%s\"\n",
+	       				    func, line,
+					    mysql_stmt_errno(stmt),
+					    mysql_stmt_sqlstate(stmt),
+					    mysql_stmt_error(stmt));
+	fatalError(msg, mysql_stmt_errno(stmt));
+}
+
+static bool retryableError(unsigned int code)
+{
+	/* lost connection, server restart, rolled back transaction */
+	switch (code) {
+		case CR_SERVER_GONE_ERROR:
+		case CR_SERVER_LOST:
+		case CR_SERVER_LOST_EXTENDED:
+		case CR_CONNECTION_ERROR:
+		case CR_CONN_HOST_ERROR:
+		case ER_CON_COUNT_ERROR:
+		case ER_SERVER_SHUTDOWN:
+		case ER_CONNECTION_KILLED:
+		case ER_NET_READ_ERROR:
+		case ER_NET_WRITE_INTERRUPTED:
+		case ER_LOCK_DEADLOCK:
+		case ER_LOCK_WAIT_TIMEOUT:
+			return true;
+		default:
+			return false;
+	}
+}
+
+void CSql::fatalError(const char* msg, unsigned int code)
+{
+	closeVideoStmts();
+	if (mysqlCon != NULL)
+		mysql_close(mysqlCon);
 	mysqlCon = NULL;
+	/* writer threads hand the error to the main thread,
+	   writeVideoBatch() retries transient errors */
+	bool retry = (retryState != retry_none) && retryableError(code);
+	bool dup   = (retryState == retry_replay) && (code == ER_DUP_ENTRY);
+	if (throwOnError || retry || dup)
+		throw CSqlError(msg, code);
+	printf("%s", msg);
 	myExit(-1);
 }
 
-bool CSql::connectMysql()
+bool CSql::connectMysql(const string& name/*="main"*/)
 {
+	bool firstConnect = connectName.empty();
+	connectName = name;
+
 	FILE* f = NULL;
 	if (file_exists(g_passwordFile.c_str()))
 		f = fopen(g_passwordFile.c_str(), "r");
@@ -123,160 +240,777 @@ bool CSql::connectMysql()
 	if (mysql_optionsv(mysqlCon, MYSQL_OPT_MAX_ALLOWED_PACKET, (const void*)(&maxAllowedPacket)) != 0)
 		show_error(__func__, __LINE__);
 
+	if (videoInsertMode == insertMode_loadData) {
+		unsigned int localInfile = 1;
+		if (mysql_optionsv(mysqlCon, MYSQL_OPT_LOCAL_INFILE, (const void*)(&localInfile)) != 0)
+			show_error(__func__, __LINE__);
+	}
+
+	/* transport: unix socket or tcp (host, port), zlib compression
+	   of the protocol (the only method of MariaDB Connector/C) */
 	unsigned long flags = 0;
 	if (multiQuery)
 		flags |= CLIENT_MULTI_STATEMENTS;
-//	flags |= CLIENT_COMPRESS;
+	if (transportCompress)
+		flags |= CLIENT_COMPRESS;
 	const char* host = g_mysqlHost.empty() ? "127.0.0.1" : g_mysqlHost.c_str();
-	if (!mysql_real_connect(mysqlCon, host, sqlUser.c_str(), sqlPW.c_str(), NULL, 3306, NULL, flags))
+	const char* socket = NULL;
+	unsigned int protocol = MYSQL_PROTOCOL_TCP;
+	if (!transportSocket.empty()) {
+		host     = "localhost";
+		socket   = transportSocket.c_str();
+		protocol = MYSQL_PROTOCOL_SOCKET;
+	}
+	if (mysql_optionsv(mysqlCon, MYSQL_OPT_PROTOCOL, (const void*)(&protocol)) != 0)
+		show_error(__func__, __LINE__);
+	if (!mysql_real_connect(mysqlCon, host, sqlUser.c_str(), sqlPW.c_str(), NULL, transportPort, socket, flags))
 		show_error(__func__, __LINE__);
+	usedDB          = "";
+	multiStatements = (multiQuery) ? 1 : 0;
+	roundTrips     += 2;	/* connect, character set */
 
 	if (mysql_set_character_set(mysqlCon, "utf8mb4") != 0)
 		show_error(__func__, __LINE__);
+	/* utf8Escape() writes backslash escapes (like mysql_real_escape_string()
+	   without the server status check), with NO_BACKSLASH_ESCAPES the server
+	   would store the backslashes and end quoted strings early */
+	if (mysqlCon->server_status & SERVER_STATUS_NO_BACKSLASH_ESCAPES) {
+		char msg[256];
+		snprintf(msg, sizeof(msg), "\n[%s:%d] sql_mode NO_BACKSLASH_ESCAPES is set for [%s], not supported.\n",
+			 __func__, __LINE__, name.c_str());
+		fatalError(msg, 0);
+	}
+
+	/* the client accepts 256 MB, the server limit decides,
+	   a reconnect keeps the statement size found so far */
+	serverMaxPacket = getServerMaxPacket();
+	if (firstConnect)
+		writeSizer.setup(name,
+				 static_cast<size_t>(g_settings.sqlStatementSize) * 1024,
+				 static_cast<size_t>(g_settings.sqlStatementSizeMax) * 1024,
+				 serverMaxPacket, g_settings.sqlStatementLatency);
+	if (g_debugPrint && firstConnect)
+		printf("[%s-debug] %s: server max_allowed_packet %zu KB, statement size %zu KB\n",
+		       g_progName, name.c_str(), serverMaxPacket / 1024, writeSizer.limit() / 1024);
+
+	if (videoInsertMode != insertMode_text) {
+		bulkAvailable = bulkInsertSupported();
+		if (!bulkAvailable)
+			printf("[%s:%d] server doesn't support bulk inserts, using text mode\n", __func__, __LINE__);
+	}
+	if (videoInsertMode == insertMode_loadData) {
+		loadDataAvailable = loadDataSupported();
+		if (!loadDataAvailable)
+			printf("[%s:%d] local_infile is disabled on the server, LOAD DATA not available\n", __func__, __LINE__);
+		mysql_set_local_infile_handler(mysqlCon, infileInit, infileRead, infileEnd, infileError, &infile);
+	}
 
 	return true;
 }
 
-string CSql::createVideoTableQuery(int count, bool startRow, bool replace, TVideoEntry* videoEntry)
+void CSql::escapeColumn(const CVideoBatch::strColumn_t& src, size_t rows, size_t maxLen, CVideoBatch::strColumn_t& dst)
 {
-	string entry = "";
-	if (startRow) {
-		entry += (replace) ? "REPLACE" : "INSERT";
-		entry += " INTO " + VIDEO_TABLE + " VALUES ";
+	/* worst case: every byte escaped */
+	size_t needed = 2*src.offsets[rows] + rows + 1;
+	if (dst.buf.length() < needed)
+		dst.buf.resize(needed);
+	if (dst.offsets.size() < (rows + 1))
+		dst.offsets.resize(rows + 1);
+
+	char* out = &dst.buf[0];
+	const char* in = src.buf.data();
+	size_t pos = 0;
+	dst.offsets[0] = 0;
+	for (size_t r = 0; r < rows; r++) {
+		size_t len = src.offsets[r+1] - src.offsets[r];
+		pos += utf8Escape(out + pos, in + src.offsets[r], len, maxLen, utf8Esc_sql, &utf8Stats);
+		dst.offsets[r+1] = static_cast<uint32_t>(pos);
 	}
-	else {
-		entry += ",";
-	}
-	entry += "(";
-	entry += checkInt(count) + ",";
-	entry += checkString(videoEntry->channel, 128) + ",";
-	entry += checkString(videoEntry->theme, 1024) + ",";
-	entry += checkString(videoEntry->title, 1024) + ",";
-	entry += checkInt(videoEntry->duration) + ",";
-	entry += checkInt(videoEntry->size_mb) + ",";
-	entry += checkString(videoEntry->description, 32768) + ",";
-	entry += checkString(videoEntry->url, 1024) + ",";
-	entry += checkString(videoEntry->website, 1024) + ",";
-	entry += checkString(videoEntry->subtitle, 1024) + ",";
-	entry += checkString(videoEntry->url_rtmp, 1024) + ",";
-	entry += checkString(videoEntry->url_small, 1024) + ",";
-	entry += checkString(videoEntry->url_rtmp_small, 1024) + ",";
-	entry += checkString(videoEntry->url_hd, 1024) + ",";
-	entry += checkString(videoEntry->url_rtmp_hd, 1024) + ",";
-	entry += checkInt(videoEntry->date_unix) + ",";
-	entry += checkString(videoEntry->url_history, 1024) + ",";
-	entry += checkString(videoEntry->geo, 1024) + ",";
-	entry += checkInt(0) + ",";
-	entry += checkInt((int)videoEntry->new_entry) + ",";
-	entry += checkInt((int)videoEntry->update);
-	entry += ")";
-
-	return entry;
-}
-
-size_t CSql::searchInfoEntry(string &channel, vector<TVideoInfoEntry> &videoInfo)
-{
-	for (size_t i = 0; i < videoInfo.size(); i++) {
-		if (channel == videoInfo[i].channel)
-			return i+1;
+}
+
+const string& CSql::escapePoolString(CStringPool& pool, vector<string>& cache, uint32_t id, size_t maxLen)
+{
+	if (id >= cache.size())
+		cache.resize(id + 1);
+	if (cache[id].empty())
+	{
+		queryBuf.clear();
+		queryBuf.addString(pool.str(id), maxLen).add(',');
+		cache[id] = queryBuf.str();
 	}
-	return 0;
+	return cache[id];
+}
+
+bool CSql::bulkInsertSupported()
+{
+	/* Array binding (COM_STMT_BULK_EXECUTE) needs MariaDB 10.2.6 or newer. */
+	const char* info = mysql_get_server_info(mysqlCon);
+	if ((info == NULL) || (strstr(info, "MariaDB") == NULL))
+		return false;
+	return (mysql_get_server_version(mysqlCon) >= 100206);
+}
+
+/* columns of the video table, in table order */
+static const char* const videoColumnNames[] = {
+	"id", "channel", "theme", "title", "duration", "size_mb", "description", "url",
+	"website", "subtitle", "url_rtmp", "url_small", "url_rtmp_small", "url_hd",
+	"url_rtmp_hd", "date_unix", "url_history", "geo", "parse_m3u8", "new_entry",
+	"update", "nkey"
+};
+
+/* An existing row keeps its id and nkey when it is updated by
+   natural key (upsert, staging table merge), new_entry is taken
+   from the list like every other column. */
+static bool videoColumnUpdated(const char* name)
+{
+	return ((strcmp(name, "id") != 0) && (strcmp(name, "nkey") != 0));
+}
+
+void CSql::addVideoVerb(string& query, int write)
+{
+	query += (write == write_replace) ? "REPLACE" : "INSERT";
+	query += " INTO " + videoWriteTable + " VALUES ";
+}
+
+void CSql::addUpsertClause(string& query, int write)
+{
+	/* markNewEntries() sets new_entry of the inserted rows */
+	if (write != write_upsert)
+		return;
+	query += " ON DUPLICATE KEY UPDATE ";
+	bool first = true;
+	for (size_t i = 0; i < videoColumns(); i++) {
+		if (!videoColumnUpdated(videoColumnNames[i]))
+			continue;
+		query += (first) ? "`" : ",`";
+		query += videoColumnNames[i];
+		query += "`=VALUES(`";
+		query += videoColumnNames[i];
+		query += "`)";
+		first = false;
+	}
+}
+
+MYSQL_STMT* CSql::prepareVideoStmt(int write)
+{
+	MYSQL_STMT*& stmt = videoStmt[write];
+	if (stmt != NULL)
+		return stmt;
+
+	/* The table is resolved at prepare time, setUsedDatabase()
+	   closes the statements. */
+	string query;
+	addVideoVerb(query, write);
+	query += "(?";
+	for (size_t i = 1; i < videoColumns(); i++)
+		query += ",?";
+	query += ")";
+	addUpsertClause(query, write);
+
+	stmt = mysql_stmt_init(mysqlCon);
+	if (stmt == NULL)
+		return NULL;
+	roundTrips++;
+	if (mysql_stmt_prepare(stmt, query.c_str(), query.length()) != 0) {
+		printf("[%s:%d] prepare failed (%s)\n", __func__, __LINE__, mysql_stmt_error(stmt));
+		mysql_stmt_close(stmt);
+		stmt = NULL;
+	}
+	return stmt;
+}
+
+void CSql::closeVideoStmts()
+{
+	for (int i = 0; i < 3; i++) {
+		if (videoStmt[i] != NULL) {
+			mysql_stmt_close(videoStmt[i]);
+			videoStmt[i] = NULL;
+		}
+	}
+}
+
+void CSql::bindBulkString(int col, size_t i, TStrView s, size_t maxLen)
+{
+	/* valid UTF-8 is bound in place, a repaired copy goes to bulkRepair */
+	size_t len;
+	if (utf8Check(s.data, s.len, maxLen, &len, &utf8Stats)) {
+		bulkStr[col][i] = const_cast<char*>(s.data);
+		bulkLen[col][i] = len;
+		return;
+	}
+	char* buf = bulkRepair.alloc(min(s.len, maxLen));
+	bulkStr[col][i] = buf;
+	bulkLen[col][i] = utf8Escape(buf, s.data, s.len, maxLen, utf8Esc_none, &utf8Stats);
+}
+
+void CSql::gatherBulkRows(CVideoBatch* batch, size_t start, size_t count)
+{
+	const int colChannel = CVideoBatch::col_count;
+	const int colTheme   = CVideoBatch::col_count + 1;
+
+	for (int c = 0; c < CVideoBatch::col_count+2; c++) {
+		bulkStr[c].resize(count);
+		bulkLen[c].resize(count);
+	}
+	for (int i = 0; i < bulk_intCount; i++)
+		bulkInt[i].resize(count);
+	bulkNew.resize(count);
+	bulkNkey.resize(count);
+	bulkZero.assign(count, 0);
+	bulkRepair.reset();
+
+	for (size_t i = 0; i < count; i++) {
+		size_t r = bulkRows[start + i];
+		for (int c = 0; c < CVideoBatch::col_count; c++)
+			bindBulkString(c, i, batch->str(c, r), videoColMaxLen[c]);
+		bindBulkString(colChannel, i, g_channelPool.str(batch->channelId[r]), 128);
+		bindBulkString(colTheme, i, g_themePool.str(batch->themeId[r]), 1024);
+
+		bulkInt[bulk_id][i]        = batch->id[r];
+		bulkInt[bulk_duration][i]  = batch->duration[r];
+		bulkInt[bulk_size_mb][i]   = batch->size_mb[r];
+		bulkInt[bulk_date_unix][i] = batch->date_unix[r];
+		bulkInt[bulk_update][i]    = batch->update[r];
+		bulkNew[i]                 = batch->new_entry[r];
+		bulkNkey[i]                = batch->nkey[r];
+	}
+}
+
+bool CSql::writeVideoBatchBulk(CVideoBatch* batch, int rows, int write, uint64_t& bytes)
+{
+	MYSQL_STMT* stmt = prepareVideoStmt(write);
+	if (stmt == NULL)
+		return false;
+
+	bulkRows.clear();
+	for (size_t r = 0; r < batch->size(); r++) {
+		if ((rows == rows_update) && batch->insertRow[r])
+			continue;
+		if ((rows == rows_insert) && !batch->insertRow[r])
+			continue;
+		bulkRows.push_back(static_cast<uint32_t>(r));
+	}
+
+	/* table column order; col = bulkStr / bulkInt index, for
+	   MYSQL_TYPE_TINY 0 = parse_m3u8 (always 0), 1 = new_entry,
+	   nkey only when the table has the column */
+	static const struct { int col; int type; } params[22] = {
+		{ bulk_id,                          MYSQL_TYPE_LONG   },
+		{ CVideoBatch::col_count,           MYSQL_TYPE_STRING },	/* channel */
+		{ CVideoBatch::col_count+1,         MYSQL_TYPE_STRING },	/* theme */
+		{ CVideoBatch::col_title,           MYSQL_TYPE_STRING },
+		{ bulk_duration,                    MYSQL_TYPE_LONG   },
+		{ bulk_size_mb,                     MYSQL_TYPE_LONG   },
+		{ CVideoBatch::col_description,     MYSQL_TYPE_STRING },
+		{ CVideoBatch::col_url,             MYSQL_TYPE_STRING },
+		{ CVideoBatch::col_website,         MYSQL_TYPE_STRING },
+		{ CVideoBatch::col_subtitle,        MYSQL_TYPE_STRING },
+		{ CVideoBatch::col_url_rtmp,        MYSQL_TYPE_STRING },
+		{ CVideoBatch::col_url_small,       MYSQL_TYPE_STRING },
+		{ CVideoBatch::col_url_rtmp_small,  MYSQL_TYPE_STRING },
+		{ CVideoBatch::col_url_hd,          MYSQL_TYPE_STRING },
+		{ CVideoBatch::col_url_rtmp_hd,     MYSQL_TYPE_STRING },
+		{ bulk_date_unix,                   MYSQL_TYPE_LONG   },
+		{ CVideoBatch::col_url_history,     MYSQL_TYPE_STRING },
+		{ CVideoBatch::col_geo,             MYSQL_TYPE_STRING },
+		{ 0,                                MYSQL_TYPE_TINY   },	/* parse_m3u8 */
+		{ 1,                                MYSQL_TYPE_TINY   },	/* new_entry */
+		{ bulk_update,                      MYSQL_TYPE_LONG   },
+		{ 0,                                MYSQL_TYPE_LONGLONG }	/* nkey */
+	};
+
+	size_t start = 0;
+	while (start < bulkRows.size()) {
+		/* one bulk execute is sent as one packet, keep it below maxLen */
+		size_t maxLen = writeSizer.limit();
+		size_t end = start;
+		size_t len = 0;
+		while (end < bulkRows.size()) {
+			size_t r = bulkRows[end];
+			size_t rowLen = videoColumns()*5 + g_channelPool.str(batch->channelId[r]).len + g_themePool.str(batch->themeId[r]).len;
+			for (int c = 0; c < CVideoBatch::col_count; c++)
+				rowLen += batch->str(c, r).len;
+			if ((end > start) && ((len + rowLen) >= maxLen))
+				break;
+			len += rowLen;
+			end++;
+		}
+		size_t count = end - start;
+		gatherBulkRows(batch, start, count);
+
+		MYSQL_BIND bind[22];
+		memset(bind, 0, sizeof(bind));
+		for (size_t i = 0; i < videoColumns(); i++) {
+			bind[i].buffer_type = static_cast<enum_field_types>(params[i].type);
+			if (params[i].type == MYSQL_TYPE_STRING) {
+				bind[i].buffer = bulkStr[params[i].col].data();
+				bind[i].length = bulkLen[params[i].col].data();
+			}
+			else if (params[i].type == MYSQL_TYPE_TINY) {
+				bind[i].buffer      = (params[i].col == 0) ? bulkZero.data() : bulkNew.data();
+				bind[i].is_unsigned = 1;
+			}
+			else if (params[i].type == MYSQL_TYPE_LONGLONG) {
+				bind[i].buffer      = bulkNkey.data();
+				bind[i].is_unsigned = 1;
+			}
+			else
+				bind[i].buffer = bulkInt[params[i].col].data();
+		}
+
+		unsigned int arraySize = static_cast<unsigned int>(count);
+		if (mysql_stmt_attr_set(stmt, STMT_ATTR_ARRAY_SIZE, &arraySize) != 0)
+			show_stmt_error(stmt, __func__, __LINE__);
+		if (mysql_stmt_bind_param(stmt, bind) != 0)
+			show_stmt_error(stmt, __func__, __LINE__);
+		double startMs = nowMs();
+		roundTrips++;
+		if (mysql_stmt_execute(stmt) != 0)
+			show_stmt_error(stmt, __func__, __LINE__);
+		writeSizer.sample(len, nowMs() - startMs);
+		bytes += len;
+		start = end;
+	}
+	return true;
 }
 
-void CSql::updateInfoTable(vector<TVideoInfoEntry> &videoInfoUpdate, vector<TVideoInfoEntry> &videoInfo)
+size_t CSql::getServerMaxPacket()
 {
-	string entry = "SELECT * FROM " + INFO_TABLE + ";";
-	executeSingleQueryString(entry);
+	size_t ret = 0;
+	executeSingleQueryString("SELECT @@max_allowed_packet;");
 	MYSQL_RES* result = mysql_store_result(mysqlCon);
 	MYSQL_ROW row;
-	while ((row = mysql_fetch_row(result))) {
-		TVideoInfoEntry vie;
-		vie.id      = atoi(row[0]);
-		vie.channel = static_cast<string>(row[1]);
-		vie.count   = atoi(row[2]);
-		vie.latest  = atoi(row[3]);
-		vie.oldest  = atoi(row[4]);
-		size_t idx  = searchInfoEntry(vie.channel, videoInfo);
-		if (idx > 0) {
-			idx        -= 1;
-			vie.count  += videoInfo[idx].count;
-			vie.latest  = max(vie.latest, videoInfo[idx].latest);
-			vie.oldest  = min(vie.oldest, videoInfo[idx].oldest);
-		}
-		videoInfoUpdate.push_back(vie);
+	if (mysql_num_fields(result) > 0) {
+		row = mysql_fetch_row(result);
+		if ((row != NULL) && (row[0] != NULL))
+			ret = strtoull(row[0], NULL, 10);
 	}
 	mysql_free_result(result);
+	return ret;
 }
 
-string CSql::createInfoTableQuery(vector<TVideoInfoEntry> *videoInfo, int size, int diffMode)
+bool CSql::loadDataSupported()
 {
-	vector<TVideoInfoEntry> videoInfoUpdate;
-	vector<TVideoInfoEntry> *videoInfoTmp;
-	string entry = "";
-	
-	if (diffMode > diffMode_none) {
-		updateInfoTable(videoInfoUpdate, *videoInfo);
-		videoInfoTmp = &videoInfoUpdate;
+	bool ret = false;
+	executeSingleQueryString("SELECT @@local_infile;");
+	MYSQL_RES* result = mysql_store_result(mysqlCon);
+	MYSQL_ROW row;
+	if (mysql_num_fields(result) > 0) {
+		row = mysql_fetch_row(result);
+		if ((row != NULL) && (row[0] != NULL))
+			ret = (atoi(row[0]) != 0);
 	}
-	else {
-		videoInfoTmp = videoInfo;
+	mysql_free_result(result);
+	return ret;
+}
+
+void CSql::appendTsvField(string& out, TStrView s, size_t maxLen)
+{
+	/* LOAD DATA rules for ESCAPED BY '\\' */
+	size_t pos = out.length();
+	out.resize(pos + 2*min(s.len, maxLen));
+	size_t n = utf8Escape(&out[pos], s.data, s.len, maxLen, utf8Esc_loadData, &utf8Stats);
+	out.resize(pos + n);
+}
+
+void CSql::appendTsvRow(string& out, CVideoBatch* batch, size_t r)
+{
+	char buf[160];
+	TStrView s;
+
+	snprintf(buf, sizeof(buf), "%d\t", batch->id[r]);
+	out += buf;
+	s = g_channelPool.str(batch->channelId[r]);
+	appendTsvField(out, s, 128);
+	out += '\t';
+	s = g_themePool.str(batch->themeId[r]);
+	appendTsvField(out, s, 1024);
+	out += '\t';
+	s = batch->str(CVideoBatch::col_title, r);
+	appendTsvField(out, s, videoColMaxLen[CVideoBatch::col_title]);
+	snprintf(buf, sizeof(buf), "\t%d\t%d\t", batch->duration[r], batch->size_mb[r]);
+	out += buf;
+	for (int c = CVideoBatch::col_description; c <= CVideoBatch::col_url_rtmp_hd; c++) {
+		s = batch->str(c, r);
+		appendTsvField(out, s, videoColMaxLen[c]);
+		out += '\t';
+	}
+	snprintf(buf, sizeof(buf), "%d\t", batch->date_unix[r]);
+	out += buf;
+	s = batch->str(CVideoBatch::col_url_history, r);
+	appendTsvField(out, s, videoColMaxLen[CVideoBatch::col_url_history]);
+	out += '\t';
+	s = batch->str(CVideoBatch::col_geo, r);
+	appendTsvField(out, s, videoColMaxLen[CVideoBatch::col_geo]);
+	snprintf(buf, sizeof(buf), "\t0\t%d\t%d", batch->new_entry[r], batch->update[r]);
+	out += buf;
+	if (videoNkey) {
+		snprintf(buf, sizeof(buf), "\t%llu", static_cast<unsigned long long>(batch->nkey[r]));
+		out += buf;
+	}
+	out += '\n';
+}
+
+int CSql::infileInit(void** ptr, const char* /*filename*/, void* userdata)
+{
+	*ptr = userdata;
+	return 0;
+}
+
+int CSql::infileRead(void* ptr, char* buf, unsigned int len)
+{
+	/* rows are converted on demand, only about 'len' bytes are buffered */
+	infileState_t* st = static_cast<infileState_t*>(ptr);
+	if (st->bufPos > 0) {
+		st->buf.erase(0, st->bufPos);
+		st->bufPos = 0;
+	}
+	while ((st->buf.length() < len) && (st->row < st->batch->size()))
+		st->sql->appendTsvRow(st->buf, st->batch, st->row++);
+
+	size_t n = min(static_cast<size_t>(len), st->buf.length());
+	memcpy(buf, st->buf.data(), n);
+	st->bufPos = n;
+	st->bytes += n;
+	return static_cast<int>(n);
+}
+
+void CSql::infileEnd(void* /*ptr*/)
+{
+}
+
+int CSql::infileError(void* /*ptr*/, char* msg, unsigned int len)
+{
+	snprintf(msg, len, "%s: local infile handler error", g_progName);
+	return CR_UNKNOWN_ERROR;
+}
+
+bool CSql::writeVideoBatchLoadData(CVideoBatch* batch, int write, uint64_t& bytes)
+{
+	infile.batch  = batch;
+	infile.row    = 0;
+	infile.bufPos = 0;
+	infile.bytes  = 0;
+	infile.buf.clear();
+
+	/* The file name is only passed to infileInit(), no file is read. */
+	string query = "LOAD DATA LOCAL INFILE '" + string(g_progName) + ".tsv' ";
+	query += (write == write_replace) ? "REPLACE " : "";
+	query += "INTO TABLE " + videoWriteTable + " CHARACTER SET utf8mb4";
+	query += " FIELDS TERMINATED BY '\\t' ESCAPED BY '\\\\' LINES TERMINATED BY '\\n';";
+	executeSingleQueryString(query);
+
+	/* LOAD DATA LOCAL implies IGNORE, errors of single rows are only
+	   warnings: "Records: 1000  Deleted: 0  Skipped: 0  Warnings: 0" */
+	unsigned int records = 0, deleted = 0, skipped = 0, warnings = 0;
+	const char* info = mysql_info(mysqlCon);
+	if ((info != NULL) &&
+	    (sscanf(info, "Records: %u Deleted: %u Skipped: %u Warnings: %u", &records, &deleted, &skipped, &warnings) == 4) &&
+	    ((skipped > 0) || (warnings > 0))) {
+		printf("[%s] %s: load data: %u of %llu rows skipped, %u warnings\n", g_progName, connectName.c_str(),
+		       skipped, static_cast<unsigned long long>(batch->size()), warnings);
+		writeStat[insertMode_loadData].skipped  += skipped;
+		writeStat[insertMode_loadData].warnings += warnings;
 	}
 
-	for (vector<TVideoInfoEntry>::iterator it = videoInfoTmp->begin(); it != videoInfoTmp->end(); ++it) {
-		if (diffMode > diffMode_none) {
-			entry += "REPLACE INTO " + INFO_TABLE + " (id, channel, count, latest, oldest) VALUES (";
-			entry += checkInt(it->id) + ", ";
+	bytes += infile.bytes;
+	infile.batch = NULL;
+	return true;
+}
+
+void CSql::writeVideoBatch(CVideoBatch* batch, int rows, int write)
+{
+	size_t count = 0;
+	for (size_t r = 0; r < batch->size(); r++) {
+		if ((rows == rows_all) || ((rows == rows_insert) == (batch->insertRow[r] != 0)))
+			count++;
+	}
+	if (count == 0)
+		return;
+	rowCounts.clear();
+
+	/* Only tables nobody reads yet are committed per batch: the
+	   temporary database of a full import and the staging table.
+	   A diff import into the live table stays one transaction,
+	   readers never see half of it; an error there ends the import
+	   and the transaction is rolled back. */
+	bool privateTarget = (usedDB == VIDEO_DB_TMP_1) || (videoWriteTable == getStagingTable());
+	if ((g_settings.sqlRetries <= 0) || !privateTarget) {
+		writeVideoBatchOnce(batch, rows, write, count);
+		return;
+	}
+
+	/* The ids are assigned by the client, writing a batch again gives
+	   the same rows. One transaction per batch, so a lost connection
+	   only loses the batch in flight. */
+	for (int attempt = 0; ; attempt++) {
+		retryState = (attempt == 0) ? retry_first : retry_replay;
+		try {
+			if (mysqlCon == NULL)
+				reconnect();
+			writeVideoBatchOnce(batch, rows, write, count);
+			if (transaction)
+				executeSingleQueryString("COMMIT;");
+			break;
 		}
-		else {
-			entry += "INSERT INTO " + INFO_TABLE + " (channel, count, latest, oldest) VALUES (";
+		catch (CSqlError const& e) {
+			retryState = retry_none;
+			if ((attempt > 0) && (e.code == ER_DUP_ENTRY)) {
+				/* only the answer to the COMMIT got lost */
+				printf("[%s] %s: batch was already written before the reconnect\n", g_progName, connectName.c_str());
+				break;
+			}
+			if (!retryableError(e.code))
+				throw;
+			if (attempt >= g_settings.sqlRetries) {
+				if (throwOnError)
+					throw;
+				printf("%s", e.what());
+				myExit(-1);
+			}
+			retries++;
+			int delay = min(1 << attempt, 30);
+			printf("[%s] %s: error %u, reconnect and retry %d/%d in %d sec\n",
+			       g_progName, connectName.c_str(), e.code, attempt + 1, g_settings.sqlRetries, delay);
+			sleep(delay);
 		}
-		entry += checkString(it->channel, 256) + ", ";
-		entry += checkInt(it->count) + ", ";
-		entry += checkInt(it->latest) + ", ";
-		entry += checkInt(it->oldest);
-		entry += ");";
 	}
-	videoInfo->clear();
-	if (diffMode > diffMode_none) {
-		videoInfoUpdate.clear();
+	retryState = retry_none;
+	if (mysqlCon == NULL)
+		reconnect();
+}
+
+void CSql::writeVideoBatchOnce(CVideoBatch* batch, int rows, int write, size_t count)
+{
+	struct timeval t1;
+	gettimeofday(&t1, NULL);
+	double startMs = (double)t1.tv_sec*1000ULL + ((double)t1.tv_usec)/1000ULL;
+	uint64_t bytes = 0;
+
+	/* LOAD DATA only for whole batches without upsert (full
+	   import, staging table), else the bulk or text path */
+	int mode = insertMode_text;
+	if ((videoInsertMode == insertMode_loadData) && loadDataAvailable && (rows == rows_all) && (write != write_upsert))
+		mode = insertMode_loadData;
+	else if ((videoInsertMode != insertMode_text) && bulkAvailable)
+		mode = insertMode_bulk;
+
+	if ((mode == insertMode_loadData) && !writeVideoBatchLoadData(batch, write, bytes))
+		mode = insertMode_bulk;
+	if ((mode == insertMode_bulk) && !writeVideoBatchBulk(batch, rows, write, bytes)) {
+		printf("[%s:%d] bulk insert not available, using text mode\n", __func__, __LINE__);
+		bulkAvailable = false;
+		mode = insertMode_text;
+	}
+	if (mode == insertMode_text)
+		writeVideoBatchText(batch, rows, write, bytes);
+
+	gettimeofday(&t1, NULL);
+	writeStat[mode].ms    += ((double)t1.tv_sec*1000ULL + ((double)t1.tv_usec)/1000ULL) - startMs;
+	writeStat[mode].rows  += count;
+	writeStat[mode].bytes += bytes;
+}
+
+string CSql::getWriteStats()
+{
+	static const char* names[insertMode_count] = { "text", "bulk", "load data" };
+	string ret = "";
+	for (int i = 0; i < insertMode_count; i++) {
+		if (writeStat[i].rows == 0)
+			continue;
+		double sec = max(writeStat[i].ms / 1000, 0.001);
+		char buf[256];
+		snprintf(buf, sizeof(buf), "%s%s: %llu rows, %.2f MB in %.2f sec (%.0f rows/sec, %.2f MB/sec)",
+			 ret.empty() ? "" : "; ", names[i],
+			 static_cast<unsigned long long>(writeStat[i].rows),
+			 (double)writeStat[i].bytes / 1048576, sec,
+			 (double)writeStat[i].rows / sec,
+			 (double)writeStat[i].bytes / 1048576 / sec);
+		ret += buf;
+		if ((writeStat[i].skipped > 0) || (writeStat[i].warnings > 0)) {
+			snprintf(buf, sizeof(buf), ", %llu skipped, %llu warnings",
+				 static_cast<unsigned long long>(writeStat[i].skipped),
+				 static_cast<unsigned long long>(writeStat[i].warnings));
+			ret += buf;
+		}
+	}
+	return ret;
+}
+
+string CSql::getUtf8Stats()
+{
+	if ((utf8Stats.truncated == 0) && (utf8Stats.repaired == 0))
+		return "";
+	return to_string(utf8Stats.truncated) + " values truncated, " + to_string(utf8Stats.repaired) + " repaired (invalid UTF-8)";
+}
+
+void CSql::mergeWriteStats(CSql* other)
+{
+	for (int i = 0; i < insertMode_count; i++) {
+		writeStat[i].rows  += other->writeStat[i].rows;
+		writeStat[i].bytes += other->writeStat[i].bytes;
+		writeStat[i].ms    += other->writeStat[i].ms;
+		writeStat[i].skipped  += other->writeStat[i].skipped;
+		writeStat[i].warnings += other->writeStat[i].warnings;
 	}
+	writeSizer.merge(other->writeSizer);
+	roundTrips += other->roundTrips;
+	retries    += other->retries;
+	/* the other connection wrote rows */
+	rowCounts.clear();
+	utf8Stats.truncated += other->utf8Stats.truncated;
+	utf8Stats.repaired  += other->utf8Stats.repaired;
+}
 
-	entry += (diffMode > diffMode_none) ? "REPLACE" : "INSERT";
-	entry += " INTO " + VERSION_TABLE + " (id, version, vdate, mvversion, mvdate, mventrys, progname, progversion) VALUES (";
-	entry += checkInt(1) + ", ";
-	string tmpStr = (string)g_dbVersion;
-	entry += checkString(tmpStr, 256) + ", ";
-	entry += checkInt(time(0)) + ", ";
-	entry += checkString(g_mvVersion, 256) + ", ";
-	entry += checkInt(g_mvDate) + ", ";
-	entry += checkInt(size) + ", ";
-	tmpStr = (string)g_progName;
-	entry += checkString(tmpStr, 256) + ", ";
-	tmpStr = (string)g_progVersion;
-	entry += checkString(tmpStr, 256);
-	entry += ");";
+void CSql::writeVideoBatchText(CVideoBatch* batch, int rows, int write, uint64_t& bytes)
+{
+	size_t count = batch->size();
+	string verb, upsert;
+	addVideoVerb(verb, write);
+	addUpsertClause(upsert, write);
+
+	/* length check and escaping, one column at a time */
+	for (int c = 0; c < CVideoBatch::col_count; c++)
+		escapeColumn(batch->column(c), count, videoColMaxLen[c], escCol[c]);
+
+	CQueryBuilder& sql = videoQuery;
+	sql.clear();
+	for (size_t r = 0; r < count; r++) {
+		if ((rows == rows_update) && batch->insertRow[r])
+			continue;
+		if ((rows == rows_insert) && !batch->insertRow[r])
+			continue;
+
+		const string& channel = escapePoolString(g_channelPool, escChannel, batch->channelId[r], 128);
+		const string& theme   = escapePoolString(g_themePool, escTheme, batch->themeId[r], 1024);
+		size_t rowLen = channel.length() + theme.length() + 9*24 + 2*CVideoBatch::col_count + 4;
+		for (int c = 0; c < CVideoBatch::col_count; c++)
+			rowLen += escCol[c].offsets[r+1] - escCol[c].offsets[r];
+		if ((!sql.empty()) && ((sql.length() + rowLen + upsert.length()) >= writeSizer.limit())) {
+			sql.add(upsert).add(";\n");
+			executeVideoQuery(sql, bytes);
+		}
 
-	return entry;
+		if (sql.empty())
+			sql.add(verb);
+		else
+			sql.add(',');
+		sql.add('(');
+		sql.addInt(batch->id[r]).add(',');
+		sql.add(channel);
+		sql.add(theme);
+		appendEscColumn(sql, CVideoBatch::col_title, r);
+		sql.addInt(batch->duration[r]).add(',');
+		sql.addInt(batch->size_mb[r]).add(',');
+		appendEscColumn(sql, CVideoBatch::col_description, r);
+		appendEscColumn(sql, CVideoBatch::col_url, r);
+		appendEscColumn(sql, CVideoBatch::col_website, r);
+		appendEscColumn(sql, CVideoBatch::col_subtitle, r);
+		appendEscColumn(sql, CVideoBatch::col_url_rtmp, r);
+		appendEscColumn(sql, CVideoBatch::col_url_small, r);
+		appendEscColumn(sql, CVideoBatch::col_url_rtmp_small, r);
+		appendEscColumn(sql, CVideoBatch::col_url_hd, r);
+		appendEscColumn(sql, CVideoBatch::col_url_rtmp_hd, r);
+		sql.addInt(batch->date_unix[r]).add(',');
+		appendEscColumn(sql, CVideoBatch::col_url_history, r);
+		appendEscColumn(sql, CVideoBatch::col_geo, r);
+		sql.add("0,");
+		sql.addInt(batch->new_entry[r]).add(',');
+		sql.addInt(batch->update[r]);
+		if (videoNkey)
+			sql.add(',').addUInt(batch->nkey[r]);
+		sql.add(')');
+	}
+	if (!sql.empty()) {
+		sql.add(upsert);
+		executeVideoQuery(sql, bytes);
+	}
 }
 
-bool CSql::executeSingleQueryString__(string query, const char* func, int line)
+void CSql::executeVideoQuery(CQueryBuilder& sql, uint64_t& bytes)
+{
+	double startMs = nowMs();
+	executeSingleQueryString(sql.str());
+	writeSizer.sample(sql.length(), nowMs() - startMs);
+	bytes += sql.length();
+	sql.clear();
+}
+
+static bool sortInfoEntry(const TVideoInfoEntry& a, const TVideoInfoEntry& b)
+{
+	if (a.id != b.id)
+		return (a.id < b.id);
+	return (a.channelId < b.channelId);
+}
+
+const string& CSql::createInfoTableQuery(videoInfoMap_t *videoInfo, int size, int diffMode)
+{
+	/* diff mode: already done by refreshChannelInfo() */
+	vector<TVideoInfoEntry> videoInfoUpdate;
+	for (videoInfoMap_t::iterator it = videoInfo->begin(); it != videoInfo->end(); ++it)
+		videoInfoUpdate.push_back(it->second);
+	/* stable row order (channels in order of first appearance) */
+	sort(videoInfoUpdate.begin(), videoInfoUpdate.end(), sortInfoEntry);
+
+	CQueryBuilder& sql = queryBuf;
+	sql.clear();
+	for (vector<TVideoInfoEntry>::iterator it = videoInfoUpdate.begin(); it != videoInfoUpdate.end(); ++it) {
+		if (it->id > 0) {
+			sql.add("REPLACE INTO ").add(INFO_TABLE).add(" (id, channel, count, latest, oldest) VALUES (");
+			sql.addInt(it->id).add(", ");
+		}
+		else {
+			sql.add("INSERT INTO ").add(INFO_TABLE).add(" (channel, count, latest, oldest) VALUES (");
+		}
+		if (it->channelId != 0)
+			sql.addString(g_channelPool.str(it->channelId), 256).add(", ");
+		else
+			sql.addString(it->channel, 256).add(", ");
+		sql.addInt(it->count).add(", ");
+		sql.addInt(it->latest).add(", ");
+		sql.addInt(it->oldest);
+		sql.add(");");
+	}
+	videoInfo->clear();
+	videoInfoUpdate.clear();
+
+	sql.add((diffMode > diffMode_none) ? "REPLACE" : "INSERT");
+	sql.add(" INTO ").add(VERSION_TABLE).add(" (id, version, vdate, mvversion, mvdate, mventrys, progname, progversion) VALUES (");
+	sql.addInt(1).add(", ");
+	sql.addString(g_dbVersion, strlen(g_dbVersion), 256).add(", ");
+	sql.addInt(time(0)).add(", ");
+	sql.addString(g_mvVersion, 256).add(", ");
+	sql.addInt(g_mvDate).add(", ");
+	sql.addInt(size).add(", ");
+	sql.addString(g_progName, strlen(g_progName), 256).add(", ");
+	sql.addString(g_progVersion, strlen(g_progVersion), 256);
+	sql.add(");");
+
+	return sql.str();
+}
+
+bool CSql::executeSingleQueryString__(const string& query, const char* func, int line)
 {
 	bool ret = true;
 
+	roundTrips++;
 	if (mysql_real_query(mysqlCon, query.c_str(), query.length()) != 0)
 		show_error(func, line);
 
 	return ret;
 }
 
-bool CSql::executeMultiQueryString__(string query, const char* func, int line)
+bool CSql::executeMultiQueryString__(const string& query, const char* func, int line)
 {
 	if (!multiQuery) {
 		printf("[%s:%d] No multiple statement execution support.\n", func, line);
 		myExit(1);
 	}
 	setServerMultiStatementsOn();
+	/* may contain anything, counted rows are no longer valid */
+	rowCounts.clear();
 
+	roundTrips++;
 	int status = mysql_real_query(mysqlCon, query.c_str(), query.length());
 	if (status)
 		show_error(func, line);
@@ -322,6 +1056,11 @@ void CSql::checkTemplateDB(string name)
 	bool dbExists = databaseExists(VIDEO_DB_TEMPLATE);
 	if (dbExists && g_debugPrint)
 		printf("[%s-debug] check i.o., database [%s] exists.\n", g_progName, VIDEO_DB_TEMPLATE.c_str());
+	/* template of an older version, without the natural key */
+	if (dbExists && !columnExists(VIDEO_DB_TEMPLATE, VIDEO_TABLE, "nkey")) {
+		printf("[%s] database [%s] has no nkey column, creating it again\n", g_progName, VIDEO_DB_TEMPLATE.c_str());
+		dbExists = false;
+	}
 
 	if (!dbExists) {
 		bool ret = createTemplateDB(name, true);
@@ -333,59 +1072,144 @@ void CSql::checkTemplateDB(string name)
 		setServerMultiStatementsOn();
 }
 
-bool CSql::createIndex(int drop)
+/* secondary indexes of the video table */
+static const struct { const char* name; const char* columns; } videoIndexes[] = {
+	{ "channel",   "`channel`"      },
+	{ "date_unix", "`date_unix`"    },
+	{ "duration",  "`duration`"     },
+	{ "theme",     "`theme`(128)"   },
+	{ "title",     "`title`(128)"   }
+};
+
+static string alterTableOption(const char* option, const string& value, const char* const* allowed)
 {
-	struct timeval t1;
-	double nowDTms;
-	double workDTms;
+	for (int i = 0; allowed[i] != NULL; i++) {
+		if (strcasecmp(value.c_str(), allowed[i]) == 0)
+			return string(", ") + option + "=" + allowed[i];
+	}
+	if (!value.empty())
+		printf("[%s] invalid %s '%s', using the server default\n", g_progName, option, value.c_str());
+	return "";
+}
 
-	string sql = "";
-	gettimeofday(&t1, NULL);
-	nowDTms = (double)t1.tv_sec*1000ULL + ((double)t1.tv_usec)/1000ULL;
-	if (drop > diffMode_none) {
-		printf("[%s] update indexes on database...", g_progName);
-		fflush(stdout);
+bool CSql::videoIndexesComplete(const string& db)
+{
+	CQueryBuilder& sql = queryBuf;
+	sql.clear();
+	sql.add("SELECT COUNT(DISTINCT INDEX_NAME) FROM information_schema.STATISTICS WHERE TABLE_SCHEMA = ");
+	sql.addString(db, 256).add(" AND TABLE_NAME = ").addString(VIDEO_TABLE, 256).add(" AND INDEX_NAME IN (");
+	size_t count = sizeof(videoIndexes) / sizeof(videoIndexes[0]);
+	for (size_t i = 0; i < count; i++) {
+		sql.addString(videoIndexes[i].name, strlen(videoIndexes[i].name), 256);
+		sql.add((i < count - 1) ? "," : ");");
+	}
+	executeSingleQueryString(sql.str());
 
-		sql = "";
-		sql += "START TRANSACTION;";
-		sql += "SET autocommit = 0;";
-		sql += "USE `" + VIDEO_DB + "`;";
+	size_t found = 0;
+	MYSQL_RES* result = mysql_store_result(mysqlCon);
+	MYSQL_ROW row;
+	if (mysql_num_fields(result) > 0) {
+		row = mysql_fetch_row(result);
+		if ((row != NULL) && (row[0] != NULL))
+			found = atoi(row[0]);
+	}
+	mysql_free_result(result);
+	return (found == count);
+}
 
-		sql += "ALTER TABLE `" + VIDEO_TABLE + "` DROP INDEX `channel`;";
-		sql += "ALTER TABLE `" + VIDEO_TABLE + "` DROP INDEX `date_unix`;";
-		sql += "ALTER TABLE `" + VIDEO_TABLE + "` DROP INDEX `duration`;";
-		sql += "ALTER TABLE `" + VIDEO_TABLE + "` DROP INDEX `theme`;";
-		sql += "ALTER TABLE `" + VIDEO_TABLE + "` DROP INDEX `title`;";
+bool CSql::columnExists(const string& db, const string& table, const string& column)
+{
+	CQueryBuilder& sql = queryBuf;
+	sql.clear();
+	sql.add("SELECT COUNT(*) FROM information_schema.COLUMNS WHERE TABLE_SCHEMA = ").addString(db, 256);
+	sql.add(" AND TABLE_NAME = ").addString(table, 256).add(" AND COLUMN_NAME = ").addString(column, 256).add(';');
+	executeSingleQueryString(sql.str());
 
-		sql += "COMMIT;";
-		executeMultiQueryString(sql);
+	int found = 0;
+	MYSQL_RES* result = mysql_store_result(mysqlCon);
+	MYSQL_ROW row;
+	if (mysql_num_fields(result) > 0) {
+		row = mysql_fetch_row(result);
+		if ((row != NULL) && (row[0] != NULL))
+			found = atoi(row[0]);
+	}
+	mysql_free_result(result);
+	return (found > 0);
+}
+
+bool CSql::createIndex(int drop, const string& db)
+{
+	/* 'USE' below, the prepared inserts are bound to the old database */
+	closeVideoStmts();
+
+	static const char* const algorithms[] = { "INPLACE", "COPY", "NOCOPY", "INSTANT", NULL };
+	static const char* const locks[]      = { "NONE", "SHARED", "EXCLUSIVE", NULL };
+	string options = alterTableOption("ALGORITHM", g_settings.indexAlgorithm, algorithms) +
+			 alterTableOption("LOCK", g_settings.indexLock, locks);
+	size_t count = sizeof(videoIndexes) / sizeof(videoIndexes[0]);
+
+	printf("[%s] %s indexes on database...", g_progName, (drop > diffMode_none) ? "update" : "create");
+	fflush(stdout);
+
+	/* The sort buffer of an InnoDB index build is the global, read
+	   only innodb_sort_buffer_size, reported with the build times. */
+	string sortBuffer = "";
+	if (tryQueryString("SELECT @@GLOBAL.innodb_sort_buffer_size;", false) == 0) {
+		MYSQL_RES* result = mysql_store_result(mysqlCon);
+		if (result != NULL) {
+			MYSQL_ROW row = mysql_fetch_row(result);
+			if ((row != NULL) && (row[0] != NULL))
+				sortBuffer = ", innodb_sort_buffer_size " + to_string(strtoull(row[0], NULL, 10) / 1024) + " KB";
+			mysql_free_result(result);
+		}
+	}
+
+	/* Single pass: one ALTER TABLE builds all indexes from one scan
+	   of the table, in diff mode the old ones are dropped in the same
+	   statement. Otherwise one ALTER TABLE per index, timed each. */
+	vector<string> alters;
+	vector<string> names;
+	if (g_settings.indexSinglePass) {
+		string sql = "ALTER TABLE `" + db + "`.`" + VIDEO_TABLE + "` ";
+		for (size_t i = 0; i < count; i++) {
+			if (drop > diffMode_none)
+				sql += string("DROP INDEX IF EXISTS `") + videoIndexes[i].name + "`, ";
+			sql += string("ADD INDEX `") + videoIndexes[i].name + "` (" + videoIndexes[i].columns + ")";
+			sql += (i < count - 1) ? ", " : "";
+		}
+		alters.push_back(sql + options + ";");
+		names.push_back("all");
 	}
 	else {
-		printf("[%s] create indexes on database...", g_progName);
-		fflush(stdout);
-	}
-
-	sql = "";
-	sql += "START TRANSACTION;";
-	sql += "SET autocommit = 0;";
-	sql += "USE `" + VIDEO_DB + "`;";
-
-	sql += "ALTER TABLE `" + VIDEO_TABLE + "` ADD INDEX `channel` (`channel`);";
-	sql += "ALTER TABLE `" + VIDEO_TABLE + "` ADD INDEX `date_unix` (`date_unix`);";
-	sql += "ALTER TABLE `" + VIDEO_TABLE + "` ADD INDEX `duration` (`duration`);";
-#if 1
-	sql += "ALTER TABLE `" + VIDEO_TABLE + "` ADD INDEX `theme` (`theme`(128));";
-	sql += "ALTER TABLE `" + VIDEO_TABLE + "` ADD INDEX `title` (`title`(128));";
-#else
-	sql += "ALTER TABLE `" + VIDEO_TABLE + "` ADD FULLTEXT INDEX `title` (`title`);";
-	sql += "ALTER TABLE `" + VIDEO_TABLE + "` ADD FULLTEXT INDEX `theme` (`theme`);";
-#endif
-	sql += "COMMIT;";
-	bool ret = executeMultiQueryString(sql);
+		for (size_t i = 0; i < count; i++) {
+			string sql = "ALTER TABLE `" + db + "`.`" + VIDEO_TABLE + "` ";
+			if (drop > diffMode_none)
+				sql += string("DROP INDEX IF EXISTS `") + videoIndexes[i].name + "`, ";
+			sql += string("ADD INDEX `") + videoIndexes[i].name + "` (" + videoIndexes[i].columns + ")";
+			alters.push_back(sql + options + ";");
+			names.push_back(videoIndexes[i].name);
+		}
+	}
 
-	gettimeofday(&t1, NULL);
-	workDTms = (double)t1.tv_sec*1000ULL + ((double)t1.tv_usec)/1000ULL;
-	printf("done (%.02f sec)\n", (workDTms-nowDTms)/1000); fflush(stdout);
+	double startMs = nowMs();
+	string report;
+	bool ret = true;
+	for (size_t i = 0; i < alters.size(); i++) {
+		double indexMs = nowMs();
+		string sql = "";
+		sql += "START TRANSACTION;";
+		sql += "SET autocommit = 0;";
+		sql += alters[i];
+		sql += "COMMIT;";
+		ret &= executeMultiQueryString(sql);
+		char buf[64];
+		snprintf(buf, sizeof(buf), "%s%s %.02f sec", report.empty() ? "" : ", ", names[i].c_str(), (nowMs() - indexMs) / 1000);
+		report += buf;
+	}
+
+	printf("done (%.02f sec)\n", (nowMs() - startMs) / 1000);
+	printf("[%s] index build: %s%s%s\n", g_progName, report.c_str(), options.c_str(), sortBuffer.c_str());
+	fflush(stdout);
 
 	return ret;
 }
@@ -430,6 +1254,9 @@ bool CSql::createTemplateDB(string name, bool quiet/* = false*/)
 	sql = str_replace(search, VIDEO_TABLE, sql);
 
 	bool ret = executeMultiQueryString(sql);
+	/* the template sql ends with 'USE <template db>' */
+	closeVideoStmts();
+	usedDB = VIDEO_DB_TEMPLATE;
 	if (!quiet)
 		printf("\n[%s] database [%s] successfully created or updated.\n", g_progName, VIDEO_DB_TEMPLATE.c_str());
 	return ret;
@@ -437,6 +1264,8 @@ bool CSql::createTemplateDB(string name, bool quiet/* = false*/)
 
 bool CSql::renameDB()
 {
+	closeVideoStmts();
+
 	struct timeval t1;
 	gettimeofday(&t1, NULL);
 	double nowDTms = (double)t1.tv_sec*1000ULL + ((double)t1.tv_usec)/1000ULL;
@@ -453,44 +1282,218 @@ bool CSql::renameDB()
 
 void CSql::setServerMultiStatementsOff__(const char* func, int line)
 {
+	if (multiStatements == 0)
+		return;
+	roundTrips++;
 	if (mysql_set_server_option(mysqlCon, MYSQL_OPTION_MULTI_STATEMENTS_OFF) != 0)
 		show_error(func, line);
+	multiStatements = 0;
 }
 
 void CSql::setServerMultiStatementsOn__(const char* func, int line)
 {
+	if (multiStatements == 1)
+		return;
+	roundTrips++;
 	if (mysql_set_server_option(mysqlCon, MYSQL_OPTION_MULTI_STATEMENTS_ON) != 0)
 		show_error(func, line);
+	multiStatements = 1;
+}
+
+size_t CSql::loadEntryIndex(const string& db, CEntryIndex& index)
+{
+	/* one streamed scan of the natural key columns */
+	double startMs = nowMs();
+	string query = "SELECT id, channel, date_unix, theme, title FROM `" + db + "`.`" + VIDEO_TABLE + "`;";
+	executeSingleQueryString(query);
+	MYSQL_RES* result = mysql_use_result(mysqlCon);
+	if (result == NULL)
+		show_error(__func__, __LINE__);
+	size_t count = 0;
+	MYSQL_ROW row;
+	while ((row = mysql_fetch_row(result))) {
+		unsigned long* lengths = mysql_fetch_lengths(result);
+		if ((row[0] == NULL) || (row[2] == NULL))
+			continue;
+		TStrView channel = strView((row[1] != NULL) ? row[1] : "", (row[1] != NULL) ? lengths[1] : 0);
+		TStrView theme   = strView((row[3] != NULL) ? row[3] : "", (row[3] != NULL) ? lengths[3] : 0);
+		TStrView title   = strView((row[4] != NULL) ? row[4] : "", (row[4] != NULL) ? lengths[4] : 0);
+		index.add(index.key(channel, atoi(row[2]), theme, title), static_cast<uint32_t>(atoi(row[0])));
+		count++;
+	}
+	bool failed = (mysql_errno(mysqlCon) != 0);
+	mysql_free_result(result);
+	if (failed)
+		show_error(__func__, __LINE__);
+	index.setLoadTime(nowMs() - startMs);
+	return count;
 }
 
-uint32_t CSql::checkEntryForUpdate(TVideoEntry* videoEntry)
+size_t CSql::loadNaturalKeys(const string& db, CEntryIndex& index)
 {
-	string sChannel = checkString(videoEntry->channel, 128);
-	string sTheme   = checkString(videoEntry->theme, 1024);
-	string sTitle   = checkString(videoEntry->title, 1024);
-	string sDate    = checkInt(videoEntry->date_unix);
+	/* like loadEntryIndex(), the keys are stored in the table */
+	double startMs = nowMs();
+	string query = "SELECT id, nkey FROM `" + db + "`.`" + VIDEO_TABLE + "` WHERE nkey IS NOT NULL;";
+	executeSingleQueryString(query);
+	MYSQL_RES* result = mysql_use_result(mysqlCon);
+	if (result == NULL)
+		show_error(__func__, __LINE__);
+	size_t count = 0;
+	MYSQL_ROW row;
+	while ((row = mysql_fetch_row(result))) {
+		if ((row[0] == NULL) || (row[1] == NULL))
+			continue;
+		index.add(strtoull(row[1], NULL, 10), static_cast<uint32_t>(atoi(row[0])));
+		count++;
+	}
+	bool failed = (mysql_errno(mysqlCon) != 0);
+	mysql_free_result(result);
+	if (failed)
+		show_error(__func__, __LINE__);
+	index.setLoadTime(nowMs() - startMs);
+	return count;
+}
 
-	string sql = "";
-	sql += "SELECT MAX(id) FROM ( ";
-		sql += "SELECT id, theme, title FROM " + g_settings.videoDb_TableVideo;
-		sql += " WHERE ( channel LIKE " + sChannel;
-		sql += " AND date_unix = " + sDate + " )";
-	sql += " ) AS dingens WHERE ( theme LIKE " + sTheme + " AND title LIKE " + sTitle + " );";
+uint32_t CSql::markNewEntries(const string& db, uint32_t lastId)
+{
+	/* Upsert diff import: only entries without a row got a new id
+	   above lastId. So the rows above lastId are the inserted ones,
+	   one range update over the primary key.
+	   'Rows matched' counts them, also those already flagged. */
+	string query = "UPDATE `" + db + "`.`" + VIDEO_TABLE + "` SET new_entry = 1 WHERE id > " + to_string(lastId) + ";";
+	executeSingleQueryString(query);
+	unsigned int matched = 0;
+	const char* info = mysql_info(mysqlCon);
+	if ((info == NULL) || (sscanf(info, "Rows matched: %u", &matched) != 1))
+		matched = static_cast<unsigned int>(mysql_affected_rows(mysqlCon));
+	return matched;
+}
 
+void CSql::deleteNaturalKeys(const string& db, const string& table, const unordered_set<uint64_t>& keys)
+{
+	/* a few thousand keys per statement */
+	CQueryBuilder& sql = queryBuf;
+	sql.clear();
+	size_t n = 0;
+	for (unordered_set<uint64_t>::const_iterator it = keys.begin(); it != keys.end(); ++it) {
+		if (sql.empty())
+			sql.add("DELETE FROM `").add(db).add("`.`").add(table).add("` WHERE `nkey` IN (");
+		else
+			sql.add(',');
+		sql.addUInt(*it);
+		if ((++n % 4096) == 0) {
+			sql.add(");");
+			executeSingleQueryString(sql.str());
+			sql.clear();
+		}
+	}
+	if (!sql.empty()) {
+		sql.add(");");
+		executeSingleQueryString(sql.str());
+	}
+	rowCounts.clear();
+}
+
+bool CSql::createStagingTable(const string& db)
+{
+	/* same columns, primary key and nkey as the video table,
+	   without the secondary indexes */
+	string stage = "`" + db + "`.`" + getStagingTable() + "`";
+	executeSingleQueryString("DROP TABLE IF EXISTS " + stage + ";");
+	executeSingleQueryString("CREATE TABLE " + stage + " LIKE `" + db + "`.`" + VIDEO_TABLE + "`;");
+	string sql = "ALTER TABLE " + stage;
+	size_t count = sizeof(videoIndexes) / sizeof(videoIndexes[0]);
+	for (size_t i = 0; i < count; i++)
+		sql += string((i > 0) ? ", " : " ") + "DROP INDEX IF EXISTS `" + videoIndexes[i].name + "`";
+	sql += ";";
+	return executeSingleQueryString(sql);
+}
+
+uint32_t CSql::mergeStagingTable(const string& db)
+{
+	/* The staging table holds the whole diff list (nkey unique, the
+	   rows without a match have ids above the last id of the video
+	   table). Matches are updated,
+	   the rest is inserted, the channel statistics of the touched
+	   channels are counted again. Runs in the open transaction. */
+	string video = "`" + db + "`.`" + VIDEO_TABLE + "`";
+	string stage = "`" + db + "`.`" + getStagingTable() + "`";
+	double startMs = nowMs();
+
+	string sql = "UPDATE " + video + " v JOIN " + stage + " s ON v.`nkey` = s.`nkey` SET ";
+	bool first = true;
+	for (size_t i = 0; i < videoColumns(); i++) {
+		if (!videoColumnUpdated(videoColumnNames[i]))
+			continue;
+		sql += string((first) ? "" : ", ") + "v.`" + videoColumnNames[i] + "` = s.`" + videoColumnNames[i] + "`";
+		first = false;
+	}
+	sql += ";";
+	executeSingleQueryString(sql);
+	uint32_t updated = static_cast<uint32_t>(mysql_affected_rows(mysqlCon));
+	double updateMs = nowMs();
+
+	sql = "INSERT INTO " + video + " SELECT ";
+	for (size_t i = 0; i < videoColumns(); i++) {
+		sql += (i > 0) ? ", " : "";
+		if (strcmp(videoColumnNames[i], "new_entry") == 0)
+			sql += "1";
+		else
+			sql += string("s.`") + videoColumnNames[i] + "`";
+	}
+	sql += " FROM " + stage + " s LEFT JOIN " + video + " v ON v.`nkey` = s.`nkey` WHERE v.`id` IS NULL;";
 	executeSingleQueryString(sql);
+	uint32_t inserted = static_cast<uint32_t>(mysql_affected_rows(mysqlCon));
+	double insertMs = nowMs();
+	rowCounts.clear();
 
-	MYSQL_RES* result = mysql_store_result(mysqlCon);
-	MYSQL_ROW row;
-	uint32_t id_ = 0;
-	uint32_t rowsCount = mysql_num_fields(result);
-	if (rowsCount > 0) {
-		row = mysql_fetch_row(result);
-		if ((row != NULL) && (row[0] != NULL))
-			id_ = atoi(row[0]);
+	refreshChannelInfo(db, "SELECT DISTINCT `channel` FROM " + stage);
+
+	printf("[%s] staging merge: %u updated (%.02f sec), %u new (%.02f sec), channelinfo %.02f sec\n",
+	       g_progName, updated, (updateMs - startMs) / 1000, inserted, (insertMs - updateMs) / 1000,
+	       (nowMs() - insertMs) / 1000);
+	fflush(stdout);
+	return inserted;
+}
+
+void CSql::refreshChannelInfo(const string& db, const string& channels)
+{
+	/* Counted again from the video table for the channels in
+	   'channels' (IN list or subquery), same values as
+	   addChannelStat(), date 0 is no oldest date. */
+	string video = "`" + db + "`.`" + VIDEO_TABLE + "`";
+	string info  = "`" + db + "`.`" + INFO_TABLE + "`";
+	string stat  = "SELECT v.`channel`, COUNT(*) AS cnt, MAX(v.`date_unix`) AS latest, "
+		       "COALESCE(MIN(NULLIF(v.`date_unix`, 0)), 2147483647) AS oldest FROM " + video + " v "
+		       "WHERE v.`channel` IN (" + channels + ") GROUP BY v.`channel`";
+	string sql = "UPDATE " + info + " ci JOIN (" + stat + ") a ON ci.`channel` = a.`channel` ";
+	sql += "SET ci.`count` = a.cnt, ci.`latest` = a.latest, ci.`oldest` = a.oldest;";
+	executeSingleQueryString(sql);
+	sql  = "INSERT INTO " + info + " (`channel`, `count`, `latest`, `oldest`) SELECT a.`channel`, a.cnt, a.latest, a.oldest ";
+	sql += "FROM (" + stat + ") a LEFT JOIN " + info + " ci ON ci.`channel` = a.`channel` WHERE ci.`id` IS NULL;";
+	executeSingleQueryString(sql);
+}
+
+void CSql::refreshChannelInfo(const string& db, videoInfoMap_t& videoInfo)
+{
+	/* diff mode: the channels of this import */
+	if (videoInfo.empty())
+		return;
+	CQueryBuilder& list = queryBuf;
+	list.clear();
+	for (videoInfoMap_t::iterator it = videoInfo.begin(); it != videoInfo.end(); ++it) {
+		if (!list.empty())
+			list.add(',');
+		list.addString(g_channelPool.str(it->second.channelId), 128);
 	}
-	mysql_free_result(result);
+	string channels = list.str();
+	refreshChannelInfo(db, channels);
+	videoInfo.clear();
+}
 
-	return id_;
+void CSql::dropStagingTable(const string& db)
+{
+	executeSingleQueryString("DROP TABLE IF EXISTS `" + db + "`.`" + getStagingTable() + "`;");
 }
 
 bool CSql::debugChannelMapping(const string& pattern)
@@ -500,7 +1503,9 @@ bool CSql::debugChannelMapping(const string& pattern)
 	sql += "SELECT v.channel, ci.channel AS mapped, COUNT(*) AS cnt ";
 	sql += "FROM " + VIDEO_DB + "." + VIDEO_TABLE + " v ";
 	sql += "LEFT JOIN " + VIDEO_DB + "." + INFO_TABLE + " ci ON v.channel = ci.channel ";
-	sql += "WHERE LOWER(v.channel) LIKE LOWER(" + checkString(likePattern, 255) + ") ";
+	queryBuf.clear();
+	queryBuf.addString(likePattern, 255);
+	sql += "WHERE LOWER(v.channel) LIKE LOWER(" + queryBuf.str() + ") ";
 	sql += "GROUP BY v.channel, ci.channel ";
 	sql += "ORDER BY cnt DESC;";
 
@@ -525,3 +1530,106 @@ bool CSql::debugChannelMapping(const string& pattern)
 
 /* TODO: Separate class for shared sql functions */
 #include "sql-common.cpp"
+
+uint64_t CSql::getSessionStatus(const string& name)
+{
+	uint64_t ret = 0;
+	executeSingleQueryString("SHOW SESSION STATUS LIKE '" + name + "';");
+	MYSQL_RES* result = mysql_store_result(mysqlCon);
+	MYSQL_ROW row;
+	if ((result != NULL) && (mysql_num_fields(result) > 1)) {
+		row = mysql_fetch_row(result);
+		if ((row != NULL) && (row[1] != NULL))
+			ret = strtoull(row[1], NULL, 10);
+	}
+	if (result != NULL)
+		mysql_free_result(result);
+	return ret;
+}
+
+bool CSql::transportBench()
+{
+	/* Sample: rows of the live video table as text INSERTs of
+	   about the configured statement size, so the compression
+	   ratio is the one of a real import. */
+	string query = "SELECT * FROM `" + VIDEO_DB + "`.`" + VIDEO_TABLE + "` LIMIT 20000;";
+	if (tryQueryString(query, false) != 0) {
+		printf("[%s] transport bench: no table %s.%s (%s), run an import first\n",
+		       g_progName, VIDEO_DB.c_str(), VIDEO_TABLE.c_str(), mysql_error(mysqlCon));
+		return false;
+	}
+	const string benchTable = "`" + VIDEO_DB + "`.`" + VIDEO_TABLE + "_bench`";
+	size_t stmtLen = static_cast<size_t>(max(g_settings.sqlStatementSize, 64)) * 1024;
+	vector<string> stmts;
+	uint64_t payload = 0;
+	MYSQL_RES* result = mysql_store_result(mysqlCon);
+	unsigned int fields = mysql_num_fields(result);
+	MYSQL_ROW row;
+	CQueryBuilder& sql = videoQuery;
+	sql.clear();
+	while ((row = mysql_fetch_row(result))) {
+		unsigned long* lengths = mysql_fetch_lengths(result);
+		sql.add((sql.empty()) ? "INSERT INTO " + benchTable + " VALUES (" : ",(");
+		for (unsigned int i = 0; i < fields; i++) {
+			if (i > 0)
+				sql.add(',');
+			if (row[i] == NULL)
+				sql.add("NULL");
+			else
+				sql.addString(row[i], lengths[i], lengths[i]);
+		}
+		sql.add(')');
+		if (sql.length() >= stmtLen) {
+			stmts.push_back(sql.str() + ";");
+			payload += stmts.back().length();
+			sql.clear();
+		}
+	}
+	mysql_free_result(result);
+	if (!sql.empty()) {
+		stmts.push_back(sql.str() + ";");
+		payload += stmts.back().length();
+		sql.clear();
+	}
+	if (stmts.empty()) {
+		printf("[%s] transport bench: table %s.%s is empty\n", g_progName, VIDEO_DB.c_str(), VIDEO_TABLE.c_str());
+		return false;
+	}
+
+	static const struct { const char* name; bool socket; bool compress; } modes[] = {
+		{ "tcp",             false, false },
+		{ "tcp+compress",    false, true  },
+		{ "socket",          true,  false },
+		{ "socket+compress", true,  true  }
+	};
+	const int rounds = 3;
+	printf("[%s] transport bench: %zu statements, %.2f MB, %d rounds per mode\n",
+	       g_progName, stmts.size(), (double)payload / 1048576, rounds);
+	for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+		if (modes[m].socket && g_settings.mysqlSocket.empty())
+			continue;
+		CSql* bench = new CSql();
+		bench->transportSocket   = (modes[m].socket) ? g_settings.mysqlSocket : "";
+		bench->transportCompress = modes[m].compress;
+		bench->connectMysql("bench");
+		bench->executeSingleQueryString("CREATE TEMPORARY TABLE " + benchTable + " LIKE `" + VIDEO_DB + "`.`" + VIDEO_TABLE + "`;");
+
+		/* bytes as counted by the server, compressed if enabled */
+		uint64_t wire = bench->getSessionStatus("Bytes_received");
+		double startMs = nowMs();
+		for (int r = 0; r < rounds; r++) {
+			bench->executeSingleQueryString("TRUNCATE TABLE " + benchTable + ";");
+			for (size_t i = 0; i < stmts.size(); i++)
+				bench->executeSingleQueryString(stmts[i]);
+		}
+		double ms = max(nowMs() - startMs, 0.001);
+		wire = bench->getSessionStatus("Bytes_received") - wire;
+		delete bench;
+
+		printf("[%s] %-16s %8.2f MB on the wire (%5.1f%%), %7.2f sec, %7.2f MB/sec\n",
+		       g_progName, modes[m].name, (double)wire / 1048576,
+		       (double)wire * 100 / (payload * rounds), ms / 1000,
+		       (double)payload * rounds / 1048576 / (ms / 1000));
+	}
+	return true;
+}
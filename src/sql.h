@@ -29,12 +29,22 @@
 #include <string.h>
 #include <unistd.h>
 
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include <mysql.h>
 
 #include "common/helpers.h"
+#include "common/utf8.h"
+#include "entryindex.h"
 #include "mv2mariadb.h"
+#include "querybuilder.h"
+#include "videobatch.h"
+#include "writesizer.h"
 
 using namespace std;
 
@@ -43,6 +53,15 @@ using namespace std;
 #define setServerMultiStatementsOff() setServerMultiStatementsOff__(__func__, __LINE__)
 #define setServerMultiStatementsOn()  setServerMultiStatementsOn__(__func__, __LINE__)
 
+/* Thrown instead of myExit() when CSql::throwOnError is set,
+ * or for a transient error while writeVideoBatch() can retry */
+class CSqlError : public runtime_error
+{
+	public:
+		unsigned int code;	/* mysql_errno() */
+		CSqlError(const string& msg, unsigned int code_ = 0) : runtime_error(msg), code(code_) {}
+};
+
 class CSql
 {
 	private:
@@ -67,46 +86,210 @@ class CSql
 
 		void Init();
 		void show_error(const char* func, int line);
-		char checkStringBuff[0xFFFF];
-		inline string checkString(string& str, int size) {
-			size_t size_ = ((size_t)size > (sizeof(checkStringBuff)-1)) ? sizeof(checkStringBuff)-1 : size;
-			string str2 = (str.length() > size_) ? str.substr(0, size_) : str;
-//			memset(checkStringBuff, 0, sizeof(checkStringBuff));
-			memset(checkStringBuff, 0, size_+1);
-			mysql_real_escape_string(mysqlCon, checkStringBuff, str2.c_str(), str2.length());
-			str2 = (string)checkStringBuff;
-			return "'" + str2 + "'";
+
+		/* session state tracked client side, saves the round trips */
+		typedef unordered_map<string, uint32_t> rowCountMap_t;
+		string        usedDB;
+		int           multiStatements;	/* -1 unknown, 0 off, 1 on */
+		rowCountMap_t rowCounts;	/* getTableEntries(), key db.table */
+		uint64_t      roundTrips;
+
+		/* transport, from g_settings */
+		string transportSocket;
+		int    transportPort;
+		bool   transportCompress;
+		uint64_t getSessionStatus(const string& name);
+
+		/* session variables changed by applySessionProfile() */
+		typedef struct {
+			string name;
+			string value;
+			string prev;
+		} sessionVar_t;
+		vector<sessionVar_t> sessionVars;
+		string profileDenied;
+		bool getSessionVariable(const string& name, string& value);
+		void fatalError(const char* msg, unsigned int code);
+
+		/* retry of writeVideoBatch() after a transient error */
+		enum {
+			retry_none,
+			retry_first,	/* first attempt of a batch */
+			retry_replay	/* ER_DUP_ENTRY: the batch was already committed */
+		};
+		int      retryState;
+		uint32_t retries;
+		bool     transaction;
+		string   connectName;
+		void reconnect();
+		TUtf8Stats utf8Stats;
+		CQueryBuilder queryBuf;		/* small statements, videoIndexesComplete() etc. */
+
+		/* column wise escaping for writeVideoBatch() */
+		CVideoBatch::strColumn_t escCol[CVideoBatch::col_count];
+		vector<string> escChannel;
+		vector<string> escTheme;
+		CQueryBuilder videoQuery;
+		void escapeColumn(const CVideoBatch::strColumn_t& src, size_t rows, size_t maxLen, CVideoBatch::strColumn_t& dst);
+		const string& escapePoolString(CStringPool& pool, vector<string>& cache, uint32_t id, size_t maxLen);
+		inline void appendEscColumn(CQueryBuilder& sql, int col, size_t row) {
+			const CVideoBatch::strColumn_t& c = escCol[col];
+			sql.addQuoted(c.buf.data() + c.offsets[row], c.offsets[row+1] - c.offsets[row]).add(',');
 		}
-		inline string checkInt(int i) { return to_string(i); }
-		size_t searchInfoEntry(string &channel, vector<TVideoInfoEntry> &videoInfo);
-		void updateInfoTable(vector<TVideoInfoEntry> &videoInfoUpdate, vector<TVideoInfoEntry> &videoInfo);
+		void refreshChannelInfo(const string& db, const string& channels);
+
+		/* videoInsertMode */
+		enum {
+			insertMode_text,	/* escaped multi-row INSERT statements */
+			insertMode_bulk,	/* prepared statement, whole columns bound */
+			insertMode_loadData,	/* LOAD DATA LOCAL INFILE (full import only) */
+			insertMode_count
+		};
+
+		/* prepared statement with array binding for writeVideoBatch() */
+		enum {
+			bulk_id,
+			bulk_duration,
+			bulk_size_mb,
+			bulk_date_unix,
+			bulk_update,
+			bulk_intCount
+		};
+		int videoInsertMode;
+		bool videoNkey;			/* the table has the nkey column */
+		string videoWriteTable;		/* VIDEO_TABLE or the staging table */
+		MYSQL_STMT* videoStmt[3];	/* write_insert, write_replace, write_upsert */
+		vector<uint32_t> bulkRows;
+		vector<char*> bulkStr[CVideoBatch::col_count+2];
+		vector<unsigned long> bulkLen[CVideoBatch::col_count+2];
+		vector<int32_t> bulkInt[bulk_intCount];
+		vector<uint8_t> bulkNew;
+		vector<uint8_t> bulkZero;
+		vector<uint64_t> bulkNkey;
+		void show_stmt_error(MYSQL_STMT* stmt, const char* func, int line);
+		bool bulkInsertSupported();
+		size_t videoColumns() const { return (videoNkey) ? 22 : 21; }
+		void addVideoVerb(string& query, int write);
+		void addUpsertClause(string& query, int write);
+		MYSQL_STMT* prepareVideoStmt(int write);
+		void closeVideoStmts();
+		CStrArena bulkRepair;
+		void bindBulkString(int col, size_t i, TStrView s, size_t maxLen);
+		void gatherBulkRows(CVideoBatch* batch, size_t start, size_t count);
+		bool writeVideoBatchBulk(CVideoBatch* batch, int rows, int write, uint64_t& bytes);
+		void writeVideoBatchText(CVideoBatch* batch, int rows, int write, uint64_t& bytes);
+		void executeVideoQuery(CQueryBuilder& sql, uint64_t& bytes);
+		void writeVideoBatchOnce(CVideoBatch* batch, int rows, int write, size_t count);
+
+		/* LOAD DATA LOCAL INFILE for writeVideoBatch(), the
+		   local infile handler serves the batch as TSV */
+		typedef struct {
+			CSql*        sql;
+			CVideoBatch* batch;
+			size_t       row;
+			string       buf;
+			size_t       bufPos;
+			uint64_t     bytes;
+		} infileState_t;
+		infileState_t infile;
+		bool bulkAvailable;
+		bool loadDataAvailable;
+		bool loadDataSupported();
+		void appendTsvField(string& out, TStrView s, size_t maxLen);
+		void appendTsvRow(string& out, CVideoBatch* batch, size_t r);
+		static int  infileInit(void** ptr, const char* filename, void* userdata);
+		static int  infileRead(void* ptr, char* buf, unsigned int len);
+		static void infileEnd(void* ptr);
+		static int  infileError(void* ptr, char* msg, unsigned int len);
+		bool writeVideoBatchLoadData(CVideoBatch* batch, int write, uint64_t& bytes);
+
+		/* throughput of writeVideoBatch() per insert mode */
+		typedef struct {
+			uint64_t rows;
+			uint64_t bytes;
+			double   ms;
+			uint64_t skipped;	/* LOAD DATA: rows not written (implied IGNORE) */
+			uint64_t warnings;	/* LOAD DATA: converted or truncated values */
+		} writeStat_t;
+		writeStat_t writeStat[insertMode_count];
+
+		/* statement size of the text and bulk path */
+		CWriteSizer writeSizer;
+		size_t serverMaxPacket;
+		size_t getServerMaxPacket();
 
 	public:
 		bool multiQuery;
+		bool throwOnError;
 
 		CSql();
 		~CSql();
-		bool connectMysql();
+		bool connectMysql(const string& name = "main");
+
+		enum {
+			rows_all,
+			rows_update,	/* diff mode: rows with an existing id */
+			rows_insert	/* diff mode: new rows */
+		};
 
-		string createVideoTableQuery(int count, bool startRow, bool replace, TVideoEntry* videoEntry);
-		string createInfoTableQuery(vector<TVideoInfoEntry> *videoInfo, int size, int diffMode);
-		bool executeSingleQueryString__(string query, const char* func, int line);
-		bool executeMultiQueryString__(string query, const char* func, int line);
+		/* statement of writeVideoBatch() */
+		enum {
+			write_insert,
+			write_replace,	/* rows with the same id are overwritten */
+			write_upsert	/* INSERT ... ON DUPLICATE KEY UPDATE, by nkey */
+		};
+
+		void writeVideoBatch(CVideoBatch* batch, int rows, int write);
+		void setVideoNkey(bool nkey) {
+			if (nkey != videoNkey)
+				closeVideoStmts();
+			videoNkey = nkey;
+		}
+		void setVideoWriteTable(const string& table) {
+			closeVideoStmts();
+			videoWriteTable = table;
+		}
+		bool columnExists(const string& db, const string& table, const string& column);
+		uint32_t markNewEntries(const string& db, uint32_t lastId);
+		void deleteNaturalKeys(const string& db, const string& table, const unordered_set<uint64_t>& keys);
+		string getStagingTable() { return VIDEO_TABLE + "_stage"; }
+		bool createStagingTable(const string& db);
+		uint32_t mergeStagingTable(const string& db);
+		void dropStagingTable(const string& db);
+		void refreshChannelInfo(const string& db, videoInfoMap_t& videoInfo);
+		void startTransaction();
+		void commitTransaction();
+		uint32_t getRetries() { return retries; }
+		string getWriteStats();
+		void mergeWriteStats(CSql* other);
+		string getUtf8Stats();
+		string getWriteSizeStats() { return writeSizer.getStats(); }
+		uint64_t getRoundTrips() { return roundTrips; }
+		const string& createInfoTableQuery(videoInfoMap_t *videoInfo, int size, int diffMode);
+		bool executeSingleQueryString__(const string& query, const char* func, int line);
+		bool executeMultiQueryString__(const string& query, const char* func, int line);
 		bool createVideoDbFromTemplate(string name);
 		void checkTemplateDB(string name);
-		bool createIndex(int drop);
+		bool createIndex(int drop, const string& db);
+		bool videoIndexesComplete(const string& db);
 		bool createTemplateDB(string name, bool quiet = false);
 		bool renameDB();
 		void setServerMultiStatementsOff__(const char* func, int line);
 		void setServerMultiStatementsOn__(const char* func, int line);
 		string getDefaultCharacterSet() { return dbDefaultCharacterSet; };
-		uint32_t checkEntryForUpdate(TVideoEntry* videoEntry);
+		size_t loadEntryIndex(const string& db, CEntryIndex& index);
+		size_t loadNaturalKeys(const string& db, CEntryIndex& index);
 		bool debugChannelMapping(const string& pattern);
+		bool transportBench();
 
 	/* sql-common.cpp */
 	/* TODO: Separate class for shared sql functions */
 	private:
 		bool intCopyOrRenameDatabase(string fromDB, string toDB, string characterSet, int mode, bool noData=false);
+		bool swapDatabase(string fromDB, string toDB, string characterSet);
+		thread dropThread;
+		static void dropDatabaseWorker(string db);
+		void dropDatabaseAsync(string db);
 
 	public:
 		bool databaseExists(string db);
@@ -116,6 +299,12 @@ class CSql
 		void setUsedDatabase(string db);
 		bool copyDatabase(string fromDB, string toDB, string characterSet, bool noData=false);
 		bool renameDatabase(string fromDB, string toDB, string characterSet);
+		vector<string> getTables(string db);
+		void waitDropDatabase();
+		int  tryQueryString(const string& query, bool freeResult = true);
+		void applySessionProfile(const string& profile);
+		void restoreSessionProfile();
+		string getSessionProfileStats();
 };
 
 #endif // __SQL_H__
@@ -47,7 +47,9 @@ CREATE TABLE `@@@tab_video@@@` (
   `parse_m3u8` int(11) NOT NULL DEFAULT '0',
   `new_entry` tinyint(1) DEFAULT NULL,
   `update` int(11) DEFAULT NULL,
-  PRIMARY KEY (`id`)
+  `nkey` bigint(20) unsigned DEFAULT NULL,
+  PRIMARY KEY (`id`),
+  UNIQUE KEY `nkey` (`nkey`)
 ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4 COLLATE=utf8mb4_unicode_ci;
 
 COMMIT;
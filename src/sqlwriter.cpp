@@ -0,0 +1,185 @@
+/*
+	mv2mariadb - convert MediathekView db to mysql
+	Copyright (C) 2015-2017, M. Liebmann 'micha-bbg'
+
+	License: GPL
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public
+	License as published by the Free Software Foundation; either
+	version 2 of the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public
+	License along with this program; if not, write to the
+	Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+	Boston, MA  02110-1301, USA.
+*/
+
+#include <stdio.h>
+#include <sys/time.h>
+
+#include "sqlwriter.h"
+
+extern GSettings		g_settings;
+[[noreturn]] extern void myExit(int val);
+
+static double nowMs()
+{
+	struct timeval t1;
+	gettimeofday(&t1, NULL);
+	return (double)t1.tv_sec*1000ULL + ((double)t1.tv_usec)/1000ULL;
+}
+
+CSqlWriterPool::CSqlWriterPool()
+{
+	maxQueued   = 0;
+	stopping    = false;
+	failed      = false;
+	startMs     = 0;
+	wallMs      = 0;
+}
+
+CSqlWriterPool::~CSqlWriterPool()
+{
+	vector<CVideoBatch*> freeBatches;
+	if (!threads.empty())
+		finish(NULL, freeBatches);
+	for (size_t i = 0; i < freeBatches.size(); i++)
+		delete freeBatches[i];
+}
+
+bool CSqlWriterPool::start(int count, const string& db, const string& table, bool sessionProfile, bool nkey)
+{
+	/* one batch per writer in flight plus one queued,
+	   the parser fills the next one meanwhile */
+	maxQueued   = count;
+	stopping    = false;
+	failed      = false;
+
+	/* connect from the main thread, each connection
+	   is used by exactly one writer thread afterwards */
+	for (int i = 0; i < count; i++) {
+		CSql* sql = new CSql();
+		sql->connectMysql("writer " + to_string(i + 1));
+		sql->throwOnError = true;
+		sql->setVideoNkey(nkey);
+		sql->setVideoWriteTable(table);
+		if (sessionProfile)
+			sql->applySessionProfile(g_settings.importSessionProfile);
+		sql->startTransaction();
+		sql->setUsedDatabase(db);
+		if (sql->multiQuery)
+			sql->setServerMultiStatementsOff();
+		writers.push_back(sql);
+	}
+
+	startMs = nowMs();
+	for (size_t i = 0; i < writers.size(); i++)
+		threads.push_back(thread(&CSqlWriterPool::run, this, writers[i]));
+	return true;
+}
+
+void CSqlWriterPool::run(CSql* sql)
+{
+	mysql_thread_init();
+	try {
+		bool commit = true;
+		for (;;) {
+			unique_lock<mutex> lock(mtx);
+			while (queue.empty() && !stopping && !failed)
+				cvWork.wait(lock);
+			if (queue.empty() || failed) {
+				commit = !failed;
+				break;
+			}
+			writeJob_t job = queue.front();
+			queue.pop_front();
+			lock.unlock();
+
+			sql->writeVideoBatch(job.batch, job.rows, job.write);
+
+			lock.lock();
+			if (!job.keep) {
+				job.batch->reset();
+				written.push_back(job.batch);
+			}
+			cvDone.notify_all();
+		}
+		if (commit) {
+			sql->commitTransaction();
+			sql->restoreSessionProfile();
+		}
+	}
+	catch (CSqlError const& e) {
+		lock_guard<mutex> lock(mtx);
+		if (!failed)
+			errorMsg = e.what();
+		failed = true;
+		cvDone.notify_all();
+		cvWork.notify_all();
+	}
+	mysql_thread_end();
+}
+
+void CSqlWriterPool::checkError()
+{
+	if (!failed)
+		return;
+	printf("%s", errorMsg.c_str());
+	myExit(-1);
+}
+
+void CSqlWriterPool::submit(CVideoBatch* batch, int rows, int write, bool keep)
+{
+	unique_lock<mutex> lock(mtx);
+	/* limit the batches in flight, the parser waits for the writers */
+	while ((queue.size() >= maxQueued) && !failed)
+		cvDone.wait(lock);
+	checkError();
+	writeJob_t job;
+	job.batch   = batch;
+	job.rows    = rows;
+	job.write   = write;
+	job.keep    = keep;
+	queue.push_back(job);
+	cvWork.notify_one();
+}
+
+CVideoBatch* CSqlWriterPool::getWrittenBatch()
+{
+	lock_guard<mutex> lock(mtx);
+	if (written.empty())
+		return NULL;
+	CVideoBatch* batch = written.back();
+	written.pop_back();
+	return batch;
+}
+
+void CSqlWriterPool::finish(CSql* statsSql, vector<CVideoBatch*>& freeBatches)
+{
+	{
+		lock_guard<mutex> lock(mtx);
+		stopping = true;
+		cvWork.notify_all();
+	}
+	for (size_t i = 0; i < threads.size(); i++)
+		threads[i].join();
+	threads.clear();
+	wallMs = nowMs() - startMs;
+	if (statsSql != NULL)
+		checkError();
+
+	for (size_t i = 0; i < writers.size(); i++) {
+		if (statsSql != NULL)
+			statsSql->mergeWriteStats(writers[i]);
+		delete writers[i];
+	}
+	writers.clear();
+	freeBatches.insert(freeBatches.end(), written.begin(), written.end());
+	written.clear();
+}
@@ -0,0 +1,87 @@
+/*
+	mv2mariadb - convert MediathekView db to mariadb
+	Copyright (C) 2015-2017, M. Liebmann 'micha-bbg'
+
+	License: GPL
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public
+	License as published by the Free Software Foundation; either
+	version 2 of the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public
+	License along with this program; if not, write to the
+	Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+	Boston, MA  02110-1301, USA.
+*/
+
+#ifndef __SQLWRITER_H__
+#define __SQLWRITER_H__
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sql.h"
+#include "videobatch.h"
+
+using namespace std;
+
+/* Pool of writer threads. Each writer has its own CSql connection with
+ * one open transaction into the import database and writes batches
+ * (ids already assigned) taken from a queue, while the parser fills
+ * the next batch. With one writer the batches are written in order.
+ * finish() is the commit barrier: it waits for the queue, lets every
+ * writer commit and closes the connections. A database error of a
+ * writer ends the program from the main thread (submit / finish). */
+class CSqlWriterPool
+{
+	private:
+		typedef struct {
+			CVideoBatch* batch;
+			int          rows;
+			int          write;		/* CSql::write_* */
+			bool         keep;		/* batch is still needed, don't recycle it */
+		} writeJob_t;
+
+		vector<CSql*>        writers;
+		vector<thread>       threads;
+		deque<writeJob_t>    queue;
+		vector<CVideoBatch*> written;
+		mutex                mtx;
+		condition_variable   cvWork;
+		condition_variable   cvDone;
+		size_t               maxQueued;
+		bool                 stopping;
+		bool                 failed;
+		string               errorMsg;
+		double               startMs;
+		double               wallMs;
+
+		void run(CSql* sql);
+		void checkError();
+
+	public:
+		CSqlWriterPool();
+		~CSqlWriterPool();
+
+		bool start(int count, const string& db, const string& table, bool sessionProfile, bool nkey);
+		void submit(CVideoBatch* batch, int rows, int write, bool keep);
+		CVideoBatch* getWrittenBatch();
+		void finish(CSql* statsSql, vector<CVideoBatch*>& freeBatches);
+
+		size_t size() const { return writers.size(); }
+		double getWallTime() const { return wallMs; }
+};
+
+#endif // __SQLWRITER_H__
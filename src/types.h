@@ -2,7 +2,10 @@
 #ifndef __TYPES_H__
 #define __TYPES_H__
 
+#include <stdint.h>
+
 #include <string>
+#include <unordered_map>
 
 using namespace std;
 
@@ -12,39 +15,19 @@ enum : int {
 	diffMode_extended = 2
 };
 
-typedef struct VideoEntry
-{
-	int    replaceID;
-	string channel;
-	string theme;
-	string title;
-	int    duration;
-	int    size_mb;
-	string description;
-	string url;
-	string website;
-	string subtitle;
-	string url_rtmp;
-	string url_small;
-	string url_rtmp_small;
-	string url_hd;
-	string url_rtmp_hd;
-	int    date_unix;
-	string url_history;
-	string geo;
-	bool   new_entry;
-	int    update;
-} TVideoEntry;
-
 typedef struct VideoInfoEntry
 {
 	int    id;
+	uint32_t channelId;	/* g_channelPool, 0 for rows read from the database */
 	string channel;
 	int    count;
 	int    latest;
 	int    oldest;
 } TVideoInfoEntry;
 
+/* per channel statistics, key is the g_channelPool id */
+typedef unordered_map<uint32_t, TVideoInfoEntry> videoInfoMap_t;
+
 enum : int {
 	maxDownloadServerCount = 32
 };
@@ -64,6 +47,21 @@ struct GSettings
 	string videoDb_TableInfo;
 	string videoDb_TableVersion;
 	string mysqlHost;
+	int    mysqlPort;
+	string mysqlSocket;		/* unix socket, empty = tcp */
+	bool   mysqlCompress;
+	int    videoInsertMode;
+	int    sqlWriterConnections;
+	int    sqlRetries;		/* per batch, 0 = exit on the first error */
+	int    sqlStatementSize;	/* KB */
+	int    sqlStatementSizeMax;	/* KB */
+	int    sqlStatementLatency;	/* ms, 0 = fixed statement size */
+	bool   indexSinglePass;
+	string indexAlgorithm;		/* ALTER TABLE ... ALGORITHM= */
+	string indexLock;		/* ALTER TABLE ... LOCK= */
+	int    indexRebuildRatio;	/* diff mode, % changed rows */
+	int    diffMergeMode;		/* 0 = upsert per batch, 1 = staging table */
+	string importSessionProfile;	/* name=value;... */
 
 	/* download server */
 	string downloadServer[maxDownloadServerCount];
@@ -79,6 +77,19 @@ struct GSettings
 	/* password file */
 	string passwordFile;
 
+	/* filter */
+	int    filterEpoch;
+	string filterChannelInclude;
+	string filterChannelExclude;
+	int    filterMinDuration;
+	string filterGeo;
+	string filterThemeRegex;
+	string filterTitleRegex;
+
+	/* url deduplication */
+	int    urlDedup;
+	int    urlDedupMaxKeys;
+
 	/* server list */
 	string serverListUrl;
 	time_t serverListLastRefresh;
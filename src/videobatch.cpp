@@ -0,0 +1,80 @@
+/*
+	mv2mariadb - convert MediathekView db to mariadb
+	Copyright (C) 2015-2017, M. Liebmann 'micha-bbg'
+
+	License: GPL
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public
+	License as published by the Free Software Foundation; either
+	version 2 of the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public
+	License along with this program; if not, write to the
+	Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+	Boston, MA  02110-1301, USA.
+*/
+
+#include "videobatch.h"
+
+CVideoBatch::CVideoBatch(size_t capacity_)
+: id(capacity_),
+  channelId(capacity_),
+  themeId(capacity_),
+  duration(capacity_),
+  size_mb(capacity_),
+  date_unix(capacity_),
+  new_entry(capacity_),
+  update(capacity_),
+  nkey(capacity_),
+  insertRow(capacity_)
+{
+	count = 0;
+	cap   = capacity_;
+	replaceRows = false;
+	for (int i = 0; i < col_count; i++) {
+		strCol[i].offsets.assign(cap + 1, 0);
+		strCol[i].buf.reserve((i == col_description) ? cap*256 : cap*64);
+	}
+}
+
+CVideoBatch::~CVideoBatch()
+{
+}
+
+void CVideoBatch::setString(int col, const char* data, size_t len)
+{
+	strColumn_t& c = strCol[col];
+	c.buf.append(data, len);
+	c.offsets[count+1] = static_cast<uint32_t>(c.buf.length());
+}
+
+void CVideoBatch::setString(int col, const char* data1, size_t len1, const char* data2, size_t len2)
+{
+	strColumn_t& c = strCol[col];
+	c.buf.append(data1, len1);
+	c.buf.append(data2, len2);
+	c.offsets[count+1] = static_cast<uint32_t>(c.buf.length());
+}
+
+void CVideoBatch::abortRow()
+{
+	for (int i = 0; i < col_count; i++) {
+		strColumn_t& c = strCol[i];
+		c.buf.resize(c.offsets[count]);
+		c.offsets[count+1] = c.offsets[count];
+	}
+}
+
+void CVideoBatch::reset()
+{
+	count = 0;
+	replaceRows = false;
+	for (int i = 0; i < col_count; i++)
+		strCol[i].buf.clear();
+}
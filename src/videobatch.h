@@ -0,0 +1,110 @@
+/*
+	mv2mariadb - convert MediathekView db to mariadb
+	Copyright (C) 2015-2017, M. Liebmann 'micha-bbg'
+
+	License: GPL
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public
+	License as published by the Free Software Foundation; either
+	version 2 of the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public
+	License along with this program; if not, write to the
+	Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+	Boston, MA  02110-1301, USA.
+*/
+
+#ifndef __VIDEOBATCH_H__
+#define __VIDEOBATCH_H__
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "common/strarena.h"
+
+using namespace std;
+
+/* Columnar (struct of arrays) batch of video entries.
+ * Each string column is one contiguous buffer plus an offset array,
+ * row r of column c is buf[offsets[r]] .. buf[offsets[r+1]].
+ * Integer columns are plain arrays. Rows are appended column by
+ * column, nothing is allocated or freed per row once the buffers
+ * have grown to their working size. reset() keeps the capacity. */
+class CVideoBatch
+{
+	public:
+		enum {
+			col_title,
+			col_description,
+			col_url,
+			col_website,
+			col_subtitle,
+			col_url_rtmp,
+			col_url_small,
+			col_url_rtmp_small,
+			col_url_hd,
+			col_url_rtmp_hd,
+			col_url_history,
+			col_geo,
+			col_count
+		};
+
+		typedef struct {
+			string           buf;
+			vector<uint32_t> offsets;
+		} strColumn_t;
+
+		/* integer columns, valid for rows < size() */
+		vector<int32_t>  id;
+		vector<uint32_t> channelId;	/* g_channelPool */
+		vector<uint32_t> themeId;	/* g_themePool */
+		vector<int32_t>  duration;
+		vector<int32_t>  size_mb;
+		vector<int32_t>  date_unix;
+		vector<uint8_t>  new_entry;
+		vector<int32_t>  update;
+		vector<uint64_t> nkey;		/* natural key, CEntryIndex::key() */
+		vector<uint8_t>  insertRow;	/* diff mode: row is not yet in the database */
+		bool replaceRows;		/* batch overwrites rows written before (url dedup) */
+
+	private:
+		strColumn_t strCol[col_count];
+		size_t count;
+		size_t cap;
+
+		CVideoBatch(const CVideoBatch&);
+		CVideoBatch& operator=(const CVideoBatch&);
+
+	public:
+		CVideoBatch(size_t capacity_);
+		~CVideoBatch();
+
+		/* Append the string columns of row size() in any order, every
+		 * column exactly once, then commitRow() or abortRow(). */
+		void setString(int col, const char* data, size_t len);
+		void setString(int col, const string& s) { setString(col, s.data(), s.length()); }
+		void setString(int col, const char* data1, size_t len1, const char* data2, size_t len2);
+		void commitRow() { count++; }
+		void abortRow();
+		void reset();
+
+		TStrView str(int col, size_t row) const {
+			const strColumn_t& c = strCol[col];
+			return strView(c.buf.data() + c.offsets[row], c.offsets[row+1] - c.offsets[row]);
+		}
+		const strColumn_t& column(int col) const { return strCol[col]; }
+
+		size_t size() const { return count; }
+		bool empty() const { return (count == 0); }
+		bool full() const { return (count >= cap); }
+};
+
+#endif // __VIDEOBATCH_H__
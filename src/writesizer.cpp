@@ -0,0 +1,148 @@
+/*
+	mv2mariadb - convert MediathekView db to mariadb
+	Copyright (C) 2015-2017, M. Liebmann 'micha-bbg'
+
+	License: GPL
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public
+	License as published by the Free Software Foundation; either
+	version 2 of the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public
+	License along with this program; if not, write to the
+	Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+	Boston, MA  02110-1301, USA.
+*/
+
+#include <stdio.h>
+
+#include <algorithm>
+
+#include "writesizer.h"
+
+extern const char*		g_progName;
+
+CWriteSizer::CWriteSizer()
+{
+	curLen    = 1048576 - 4096;
+	minLen    = lowerBound;
+	maxLen    = curLen;
+	targetMs  = 0;
+	direction = 0;
+	holdCount = 0;
+	lastRate  = 0;
+	winBytes  = 0;
+	winMs     = 0;
+	winCount  = 0;
+	minUsed   = curLen;
+	maxUsed   = curLen;
+	changes   = 0;
+}
+
+CWriteSizer::~CWriteSizer()
+{
+}
+
+void CWriteSizer::setup(const string& name_, size_t start, size_t max, size_t serverMaxPacket, double targetMs_)
+{
+	name     = name_;
+	targetMs = targetMs_;
+	maxLen   = max;
+	if ((serverMaxPacket > 0) && (serverMaxPacket < maxLen + headroom))
+		maxLen = (serverMaxPacket > minLen + headroom) ? serverMaxPacket - headroom : minLen;
+	if (maxLen < minLen)
+		maxLen = minLen;
+	curLen    = std::min(std::max(start, minLen), maxLen);
+	/* latency 0: fixed statement size */
+	direction = (targetMs > 0) ? 1 : 0;
+	holdCount = 0;
+	lastRate  = 0;
+	winBytes  = 0;
+	winMs     = 0;
+	winCount  = 0;
+	minUsed   = curLen;
+	maxUsed   = curLen;
+	changes   = 0;
+}
+
+void CWriteSizer::sample(size_t bytes, double ms)
+{
+	/* the short tail statement of a batch says nothing about the size */
+	if ((targetMs <= 0) || (bytes < curLen / 2))
+		return;
+	winBytes += bytes;
+	winMs    += ms;
+	if (++winCount < windowStatements)
+		return;
+
+	double rate    = (double)winBytes / std::max(winMs, 0.001);
+	double latency = winMs / winCount;
+	winBytes = 0;
+	winMs    = 0;
+	winCount = 0;
+
+	size_t len = curLen;
+	if ((latency > targetMs) && (curLen > minLen)) {
+		direction = -1;
+		len = curLen * 3 / 4;
+	}
+	else if (direction == 0) {
+		/* hold the best size, probe upwards now and then */
+		if ((++holdCount >= holdWindows) && (latency < targetMs / 2)) {
+			holdCount = 0;
+			direction = 1;
+			len = curLen * 3 / 2;
+		}
+	}
+	else if ((lastRate == 0) || (rate > lastRate * 1.05)) {
+		/* still improving, continue in the same direction */
+		len = (direction > 0) ? curLen * 3 / 2 : curLen * 3 / 4;
+	}
+	else if (rate < lastRate * 0.95) {
+		/* worse than the previous size, step back and hold */
+		len = (direction > 0) ? curLen * 2 / 3 : curLen * 4 / 3;
+		direction = 0;
+		holdCount = 0;
+	}
+	else
+		direction = 0;
+	lastRate = rate;
+
+	len = std::min(std::max(len, minLen), maxLen);
+	if (len != curLen)
+		setLen(len, rate, latency);
+	else if ((direction != 0) && ((len == minLen) || (len == maxLen)))
+		direction = 0;
+}
+
+void CWriteSizer::setLen(size_t len, double rate, double latency)
+{
+	printf("[%s] %s: statement size %zu KB -> %zu KB (%.2f MB/sec, %.0f ms/statement)\n",
+	       g_progName, name.c_str(), curLen / 1024, len / 1024,
+	       rate * 1000 / 1048576, latency);
+	curLen  = len;
+	minUsed = std::min(minUsed, len);
+	maxUsed = std::max(maxUsed, len);
+	changes++;
+}
+
+void CWriteSizer::merge(const CWriteSizer& other)
+{
+	minUsed  = std::min(minUsed, other.minUsed);
+	maxUsed  = std::max(maxUsed, other.maxUsed);
+	changes += other.changes;
+}
+
+string CWriteSizer::getStats() const
+{
+	char buf[256];
+	snprintf(buf, sizeof(buf), "%zu KB now, %zu - %zu KB used, %u adjustments, limit %zu KB",
+		 curLen / 1024, minUsed / 1024, maxUsed / 1024, changes, maxLen / 1024);
+	return buf;
+}
@@ -0,0 +1,81 @@
+/*
+	mv2mariadb - convert MediathekView db to mariadb
+	Copyright (C) 2015-2017, M. Liebmann 'micha-bbg'
+
+	License: GPL
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public
+	License as published by the Free Software Foundation; either
+	version 2 of the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public
+	License along with this program; if not, write to the
+	Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+	Boston, MA  02110-1301, USA.
+*/
+
+#ifndef __WRITESIZER_H__
+#define __WRITESIZER_H__
+
+#include <stdint.h>
+
+#include <string>
+
+using namespace std;
+
+/* Statement size of the text and bulk inserts of one connection.
+ * Starts at 'sqlStatementSize' and climbs towards the size with the
+ * best measured throughput, between a fixed lower bound and the
+ * smaller of 'sqlStatementSizeMax' and the server max_allowed_packet.
+ * Windows with a mean latency above 'sqlStatementLatency' shrink it. */
+class CWriteSizer
+{
+	private:
+		enum {
+			windowStatements = 8,	/* statements per measurement */
+			holdWindows      = 16	/* windows before probing again */
+		};
+
+		string   name;
+		size_t   curLen;
+		size_t   minLen;
+		size_t   maxLen;
+		double   targetMs;
+		int      direction;	/* +1 grow, -1 shrink, 0 hold */
+		int      holdCount;
+		double   lastRate;	/* bytes/ms of the previous window */
+
+		uint64_t winBytes;
+		double   winMs;
+		int      winCount;
+
+		size_t   minUsed;
+		size_t   maxUsed;
+		uint32_t changes;
+
+		void setLen(size_t len, double rate, double latency);
+
+	public:
+		enum {
+			lowerBound = 65536,
+			headroom   = 16384	/* packet header, statement head */
+		};
+
+		CWriteSizer();
+		~CWriteSizer();
+
+		void setup(const string& name_, size_t start, size_t max, size_t serverMaxPacket, double targetMs_);
+		size_t limit() const { return curLen; }
+		void sample(size_t bytes, double ms);
+
+		void merge(const CWriteSizer& other);
+		string getStats() const;
+};
+
+#endif // __WRITESIZER_H__
@@ -0,0 +1,131 @@
+/*
+	mv2mariadb - convert MediathekView db to mariadb
+	Copyright (C) 2015-2017, M. Liebmann 'micha-bbg'
+
+	License: GPL
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public
+	License as published by the Free Software Foundation; either
+	version 2 of the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public
+	License along with this program; if not, write to the
+	Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+	Boston, MA  02110-1301, USA.
+*/
+
+/* make check: the channel statistics of a list don't depend on the
+ * order of the entries (sorted by channel or shuffled). */
+
+#include <limits.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "../src/channelstats.h"
+
+typedef struct {
+	uint32_t channelId;
+	int      date;
+} entry_t;
+
+static bool sameStats(const videoInfoMap_t& a, const videoInfoMap_t& b)
+{
+	if (a.size() != b.size())
+		return false;
+	for (videoInfoMap_t::const_iterator it = a.begin(); it != a.end(); ++it) {
+		videoInfoMap_t::const_iterator other = b.find(it->first);
+		if (other == b.end())
+			return false;
+		if ((it->second.count != other->second.count) ||
+		    (it->second.latest != other->second.latest) ||
+		    (it->second.oldest != other->second.oldest) ||
+		    (it->second.channelId != other->second.channelId))
+			return false;
+	}
+	return true;
+}
+
+int main()
+{
+	mt19937 rng(4711);
+	vector<entry_t> list;
+	for (int i = 0; i < 20000; i++) {
+		entry_t e;
+		e.channelId = 1 + (rng() % 40);
+		/* some entries without a date */
+		e.date = ((rng() % 50) == 0) ? 0 : 1500000000 + static_cast<int>(rng() % 100000000);
+		list.push_back(e);
+	}
+
+	/* reference, computed per channel */
+	videoInfoMap_t expected;
+	for (uint32_t ch = 1; ch <= 40; ch++) {
+		TVideoInfoEntry vie;
+		vie.id        = 0;
+		vie.channelId = ch;
+		vie.count     = 0;
+		vie.latest    = INT_MIN;
+		vie.oldest    = INT_MAX;
+		for (size_t i = 0; i < list.size(); i++) {
+			if (list[i].channelId != ch)
+				continue;
+			vie.count++;
+			vie.latest = max(vie.latest, list[i].date);
+			if (list[i].date != 0)
+				vie.oldest = min(vie.oldest, list[i].date);
+		}
+		if (vie.count > 0)
+			expected[ch] = vie;
+	}
+
+	vector<entry_t> sorted = list;
+	stable_sort(sorted.begin(), sorted.end(),
+		    [](const entry_t& a, const entry_t& b) { return a.channelId < b.channelId; });
+	vector<entry_t> shuffled = list;
+	shuffle(shuffled.begin(), shuffled.end(), rng);
+
+	videoInfoMap_t fromSorted, fromShuffled;
+	for (size_t i = 0; i < sorted.size(); i++)
+		addChannelStat(fromSorted, sorted[i].channelId, sorted[i].date);
+	for (size_t i = 0; i < shuffled.size(); i++)
+		addChannelStat(fromShuffled, shuffled[i].channelId, shuffled[i].date);
+
+	int ret = 0;
+	if (!sameStats(expected, fromSorted)) {
+		printf("channelstats: sorted list differs from the reference\n");
+		ret = 1;
+	}
+	if (!sameStats(expected, fromShuffled)) {
+		printf("channelstats: shuffled list differs from the reference\n");
+		ret = 1;
+	}
+
+	/* a replaced entry (url dedup) only lowers the count */
+	videoInfoMap_t removed = fromShuffled;
+	uint32_t ch = shuffled[0].channelId;
+	removeChannelStat(removed, ch);
+	if ((removed[ch].count != fromShuffled[ch].count - 1) || (removed[ch].latest != fromShuffled[ch].latest)) {
+		printf("channelstats: removeChannelStat() failed\n");
+		ret = 1;
+	}
+	videoInfoMap_t single;
+	addChannelStat(single, 7, 0);
+	removeChannelStat(single, 7);
+	if (!single.empty()) {
+		printf("channelstats: empty channel not removed\n");
+		ret = 1;
+	}
+
+	if (ret == 0)
+		printf("channelstats: %zu entries, %zu channels ok\n", list.size(), expected.size());
+	return ret;
+}
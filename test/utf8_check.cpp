@@ -0,0 +1,229 @@
+/*
+	mv2mariadb - convert MediathekView db to mariadb
+	Copyright (C) 2015-2017, M. Liebmann 'micha-bbg'
+
+	License: GPL
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public
+	License as published by the Free Software Foundation; either
+	version 2 of the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	General Public License for more details.
+
+	You should have received a copy of the GNU General Public
+	License along with this program; if not, write to the
+	Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+	Boston, MA  02110-1301, USA.
+*/
+
+/* make check: utf8Escape() / utf8Check() against a byte by byte
+ * reference. The plain runs around the SIMD block sizes (15/16/31/32
+ * bytes), cuts inside a sequence at maxLen and invalid sequences are
+ * covered for all modes. The SIMD path is the one the build selects
+ * (SSE2 on x86_64, EXTRA_CXXFLAGS=-mavx2 for AVX2). */
+
+#include <stdio.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../src/common/utf8.h"
+
+using namespace std;
+
+/* length of the valid sequence at in[i], 0 if invalid (decoded, not by lead byte ranges) */
+static size_t refSequenceLen(const string& in, size_t i)
+{
+	unsigned char c = in[i];
+	size_t n;
+	uint32_t cp, min;
+	if ((c & 0xE0) == 0xC0)      { n = 2; cp = c & 0x1F; min = 0x80; }
+	else if ((c & 0xF0) == 0xE0) { n = 3; cp = c & 0x0F; min = 0x800; }
+	else if ((c & 0xF8) == 0xF0) { n = 4; cp = c & 0x07; min = 0x10000; }
+	else
+		return 0;
+	if (i + n > in.length())
+		return 0;
+	for (size_t k = 1; k < n; k++) {
+		unsigned char cc = in[i + k];
+		if ((cc & 0xC0) != 0x80)
+			return 0;
+		cp = (cp << 6) | (cc & 0x3F);
+	}
+	if ((cp < min) || (cp > 0x10FFFF) || ((cp >= 0xD800) && (cp <= 0xDFFF)))
+		return 0;
+	return n;
+}
+
+static char refEscape(unsigned char c, int mode)
+{
+	if (mode == utf8Esc_sql) {
+		switch (c) {
+			case 0:    return '0';
+			case '\n': return 'n';
+			case '\r': return 'r';
+			case '\\': return '\\';
+			case '\'': return '\'';
+			case '"':  return '"';
+			case 032:  return 'Z';
+		}
+	}
+	else if (mode == utf8Esc_loadData) {
+		switch (c) {
+			case 0:    return '0';
+			case '\t': return 't';
+			case '\n': return 'n';
+			case '\r': return 'r';
+			case '\\': return '\\';
+		}
+	}
+	return 0;
+}
+
+static string refUtf8Escape(const string& in, size_t maxLen, int mode, bool* repaired)
+{
+	string out;
+	size_t end = min(in.length(), maxLen);
+	size_t i = 0;
+	*repaired = false;
+	while (i < end) {
+		unsigned char c = in[i];
+		if (c < 0x80) {
+			char e = refEscape(c, mode);
+			if (e != 0) {
+				out += '\\';
+				out += e;
+			}
+			else
+				out += static_cast<char>(c);
+			i++;
+			continue;
+		}
+		size_t n = refSequenceLen(in, i);
+		if (n == 0) {
+			out += '?';
+			*repaired = true;
+			i++;
+			continue;
+		}
+		if (i + n > end)
+			break;
+		out.append(in, i, n);
+		i += n;
+	}
+	return out;
+}
+
+static int failures = 0;
+static size_t cases = 0;
+
+static string hex(const string& s)
+{
+	string ret;
+	char buf[4];
+	for (size_t i = 0; i < s.length(); i++) {
+		snprintf(buf, sizeof(buf), "%02x", static_cast<unsigned char>(s[i]));
+		ret += buf;
+	}
+	return ret;
+}
+
+static void check(const string& in, size_t maxLen)
+{
+	vector<char> out(2 * in.length() + 1);
+	for (int mode = utf8Esc_none; mode <= utf8Esc_loadData; mode++) {
+		cases++;
+		bool repaired;
+		string expected = refUtf8Escape(in, maxLen, mode, &repaired);
+		TUtf8Stats stats = { 0, 0 };
+		size_t len = utf8Escape(out.data(), in.data(), in.length(), maxLen, mode, &stats);
+		string got(out.data(), len);
+		bool ok = (got == expected) &&
+			  (stats.truncated == ((in.length() > maxLen) ? 1U : 0U)) &&
+			  (stats.repaired == (repaired ? 1U : 0U));
+		if (mode == utf8Esc_none) {
+			size_t checkLen = 0;
+			TUtf8Stats checkStats = { 0, 0 };
+			bool valid = utf8Check(in.data(), in.length(), maxLen, &checkLen, &checkStats);
+			if (valid == repaired)
+				ok = false;
+			else if (valid && ((checkLen != expected.length()) || (checkStats.truncated != stats.truncated)))
+				ok = false;
+		}
+		if (!ok && (failures++ < 10))
+			printf("utf8: mode %d, maxLen %zu, in %s\n      got %s\n expected %s\n",
+			       mode, maxLen, hex(in).c_str(), hex(got).c_str(), hex(expected).c_str());
+	}
+}
+
+static const char* const pieces[] = {
+	"\xC3\xA4",		/* ä */
+	"\xE2\x82\xAC",		/* € */
+	"\xF0\x9F\x98\x80",	/* U+1F600 */
+	"\xF4\x8F\xBF\xBF",	/* U+10FFFF */
+	"\x80",			/* lone continuation */
+	"\xC0\xAF",		/* overlong */
+	"\xE0\x80\xAF",		/* overlong */
+	"\xED\xA0\x80",		/* surrogate */
+	"\xF4\x90\x80\x80",	/* > U+10FFFF */
+	"\xF5\x80\x80\x80",
+	"\xFF",
+	"\xE2\x82",		/* sequence cut by the next byte */
+	"\xF0\x9F\x98",
+	"\\", "'", "\"", "\n", "\r", "\t", "\032",
+};
+
+int main()
+{
+	const size_t pieceCount = sizeof(pieces) / sizeof(pieces[0]);
+
+	/* one special / multi byte piece in a plain run, at the block boundaries */
+	const size_t positions[] = { 0, 1, 14, 15, 16, 17, 30, 31, 32, 33, 47, 48, 63, 64 };
+	for (size_t p = 0; p < pieceCount; p++) {
+		for (size_t i = 0; i < sizeof(positions) / sizeof(positions[0]); i++) {
+			string in(positions[i], 'a');
+			in += pieces[p];
+			in += string(40, 'b');
+			for (size_t maxLen = 0; maxLen <= in.length() + 1; maxLen++)
+				check(in, maxLen);
+		}
+		/* embedded NUL */
+		string nul = string(15, 'x') + string(1, '\0') + pieces[p] + string(17, 'y');
+		for (size_t maxLen = 0; maxLen <= nul.length(); maxLen++)
+			check(nul, maxLen);
+	}
+
+	/* plain runs only */
+	for (size_t len = 0; len <= 70; len++) {
+		string in(len, 'z');
+		check(in, len);
+		check(in, len / 2);
+	}
+
+	/* random mix */
+	mt19937 rng(4711);
+	for (int n = 0; n < 20000; n++) {
+		string in;
+		size_t parts = rng() % 12;
+		for (size_t k = 0; k < parts; k++) {
+			if (rng() % 2)
+				in += string(rng() % 40, static_cast<char>('A' + rng() % 26));
+			else
+				in += pieces[rng() % pieceCount];
+		}
+		check(in, in.length());
+		check(in, rng() % (in.length() + 2));
+	}
+
+	if (failures > 0) {
+		printf("utf8: %d of %zu cases failed\n", failures, cases);
+		return 1;
+	}
+	printf("utf8: %zu cases ok\n", cases);
+	return 0;
+}